@@ -1,13 +1,54 @@
-QT += gui
+QT += gui concurrent
 
 HEADERS += $$PWD/qsourcehighlighter.h \
+           $$PWD/qsourcebatchhighlighter.h \
+           $$PWD/qsourceblockdata.h \
+           $$PWD/qsourcehighlightcache.h \
+           $$PWD/qsourcehighlightscheduler.h \
            $$PWD/languages/language_others.json.autosave \
-           $$PWD/languagedata.h
+           $$PWD/languagedata.h \
+           $$PWD/annotationmatcher.h
 
 SOURCES += $$PWD/qsourcehighlighter.cpp \
-    $$PWD/languagedata.cpp
+    $$PWD/qsourcebatchhighlighter.cpp \
+    $$PWD/qsourcehighlightcache.cpp \
+    $$PWD/qsourcehighlightscheduler.cpp \
+    $$PWD/languagedata.cpp \
+    $$PWD/annotationmatcher.cpp
 
-RESOURCES += $$PWD/qsourcehighlighterlanguages.qrc
+# CONFIG += qsourcehighlighter_static_languages compiles the language
+# definitions into the library instead of parsing the JSON files at runtime
+qsourcehighlighter_static_languages {
+    isEmpty(QSOURCEHIGHLIGHTER_PYTHON): QSOURCEHIGHLIGHTER_PYTHON = python3
+
+    DEFINES += QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+    HEADERS += $$PWD/languagetables.h
+
+    LANGUAGE_INDEX = $$PWD/languages/languages.json
+    languagetables.input = LANGUAGE_INDEX
+    languagetables.output = languagetables.cpp
+    languagetables.commands = $$QSOURCEHIGHLIGHTER_PYTHON $$PWD/tools/generate_languages.py ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+    languagetables.depends = $$PWD/tools/generate_languages.py $$files($$PWD/languages/language_*.json)
+    languagetables.variable_out = GENERATED_SOURCES
+    QMAKE_EXTRA_COMPILERS += languagetables
+} else {
+    RESOURCES += $$PWD/qsourcehighlighterlanguages.qrc
+}
+
+# the viewer widget for huge files, CONFIG += qsourcehighlighter_no_widgets
+# leaves it out for applications without QtWidgets
+!qsourcehighlighter_no_widgets {
+    QT += widgets
+    HEADERS += $$PWD/qsourcecodeviewer.h
+    SOURCES += $$PWD/qsourcecodeviewer.cpp
+}
+
+# the highlighting service shared by the processes of a user, see daemon/
+qsourcehighlighter_service {
+    QT += network
+    HEADERS += $$PWD/qsourcehighlightservice.h
+    SOURCES += $$PWD/qsourcehighlightservice.cpp
+}
 
 DISTFILES += $$files( $$PWD/languages/*.json)
 
@@ -3,6 +3,8 @@ QT       += core gui
 include(QSourceHighlighter.pri)
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+# the stress mode of the demo types with QTest key events
+QT += testlib
 
 CONFIG += c++11
 DEFINES += QT_DEPRECATED_WARNINGS
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "annotationmatcher.h"
+
+#include <QMap>
+#include <algorithm>
+
+AnnotationMatcher::AnnotationMatcher( const QVector< QString >& Patterns )
+    : firstChars{ 0, 0, 0, 0, 0, 0, 0, 0 }
+    , otherFirstChars( false )
+{
+    // the trie, with its edges in maps while it is built
+    QVector< QMap< quint16, int > > Children( 1 );
+    nodes.append( Node{ 0, 0, 0, -1 } );
+
+    for ( int P = 0; P < Patterns.size(); ++P )
+    {
+        const QString& Pattern = Patterns.at( P );
+        if ( Pattern.isEmpty() )
+            continue;
+
+        const quint16 First = Pattern.at( 0 ).unicode();
+        if ( First < 256 )
+            firstChars[ First >> 5 ] |= 1u << ( First & 31 );
+        else
+            otherFirstChars = true;
+
+        int State = 0;
+        for ( const QChar C : Pattern )
+        {
+            int Next = Children[ State ].value( C.unicode(), -1 );
+            if ( Next < 0 )
+            {
+                Next = nodes.size();
+                Children[ State ].insert( C.unicode(), Next );
+                Children.append( QMap< quint16, int >() );
+                nodes.append( Node{ 0, 0, 0, -1 } );
+            }
+            State = Next;
+        }
+        // the first of equal patterns wins
+        if ( nodes[ State ].output < 0 )
+            nodes[ State ].output = P;
+    }
+
+    // flatten the edges, QMap keeps them sorted
+    for ( int N = 0; N < nodes.size(); ++N )
+    {
+        nodes[ N ].firstEdge = edges.size();
+        nodes[ N ].edgeCount = Children[ N ].size();
+        for ( auto It = Children[ N ].cbegin(); It != Children[ N ].cend(); ++It )
+            edges.append( Edge{ It.key(), It.value() } );
+    }
+
+    // fail links breadth first, so the fail node of a node is complete before it
+    QVector< int > Queue;
+    for ( int E = 0; E < nodes[ 0 ].edgeCount; ++E )
+        Queue.append( edges[ E ].next );
+    for ( int Q = 0; Q < Queue.size(); ++Q )
+    {
+        const Node N = nodes[ Queue[ Q ] ];
+        for ( int E = N.firstEdge; E < N.firstEdge + N.edgeCount; ++E )
+        {
+            const int Child = edges[ E ].next;
+            int       Fail  = N.fail;
+            int       Next;
+            while ( ( Next = transition( Fail, edges[ E ].c ) ) < 0 && Fail != 0 )
+                Fail = nodes[ Fail ].fail;
+            nodes[ Child ].fail = ( Next < 0 || Next == Child ) ? 0 : Next;
+            // a node without a pattern of its own reports the longest one ending there
+            if ( nodes[ Child ].output < 0 )
+                nodes[ Child ].output = nodes[ nodes[ Child ].fail ].output;
+            Queue.append( Child );
+        }
+    }
+}
+
+int AnnotationMatcher::transition( int State, quint16 C ) const
+{
+    const Node& N     = nodes[ State ];
+    const Edge* Begin = edges.constData() + N.firstEdge;
+    const Edge* End   = Begin + N.edgeCount;
+    const Edge* It    = std::lower_bound( Begin, End, C, []( const Edge& E, quint16 V ) { return E.c < V; } );
+    return ( It != End && It->c == C ) ? It->next : -1;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Aho-Corasick automaton finding a set of literal patterns in one pass
+ * @details Used for the annotations in comments and strings, see
+ * QSourceHighlighter::setAnnotations(). While no pattern is partially
+ * matched, the chars that can't start one are skipped with a bitmap test.
+ */
+class AnnotationMatcher
+{
+public:
+    explicit AnnotationMatcher( const QVector< QString >& Patterns );
+
+    /**
+     * @brief finds the patterns in Text from From to To
+     * @param OnMatch called as OnMatch( pattern, end ) for the longest
+     * pattern ending at end, exclusive. It returns where to continue, or
+     * -1 to ignore the match and continue after it.
+     */
+    template< typename F >
+    void scan( const QChar* Text, int From, int To, F OnMatch ) const
+    {
+        int State = 0;
+        for ( int I = From; I < To; ++I )
+        {
+            if ( State == 0 )
+            {
+                while ( I < To && !startsPattern( Text[ I ].unicode() ) )
+                    ++I;
+                if ( I == To )
+                    break;
+            }
+
+            const quint16 C = Text[ I ].unicode();
+            int           Next;
+            while ( ( Next = transition( State, C ) ) < 0 && State != 0 )
+                State = nodes[ State ].fail;
+            State = ( Next < 0 ) ? 0 : Next;
+
+            const int Pattern = nodes[ State ].output;
+            if ( Pattern >= 0 )
+            {
+                const int Resume = OnMatch( Pattern, I + 1 );
+                if ( Resume >= 0 )
+                {
+                    I     = qMax( I, Resume - 1 );
+                    State = 0;
+                }
+            }
+        }
+    }
+
+private:
+    struct Node
+    {
+        int firstEdge;
+        int edgeCount;
+        int fail;
+        int output; // longest pattern that is a suffix of the node, or -1
+    };
+
+    struct Edge
+    {
+        quint16 c;
+        int     next;
+    };
+
+    bool startsPattern( quint16 C ) const
+    {
+        return ( C < 256 ) ? ( firstChars[ C >> 5 ] >> ( C & 31 ) ) & 1 : otherFirstChars;
+    }
+
+    int transition( int State, quint16 C ) const;
+
+    QVector< Node > nodes;
+    QVector< Edge > edges; // sorted by c for each node
+    quint32         firstChars[ 8 ];
+    bool            otherFirstChars;
+};
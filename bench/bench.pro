@@ -0,0 +1,22 @@
+QT       += core gui widgets
+
+# replays edit traces against a highlighted document, see traces/
+TARGET = qsourcehighlighter_bench
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QSOURCEHIGHLIGHTER_BENCH_TRACES=\\\"$$PWD/traces\\\"
+
+include(../QSourceHighlighter.pri)
+
+SOURCES += \
+    edittrace.cpp \
+    main.cpp
+
+HEADERS += \
+    edittrace.h
+
+DISTFILES += \
+    $$files(traces/*.trace) \
+    $$files(documents/*)
@@ -0,0 +1,4 @@
+table:  .byte 246, 64, 79, 111, 202, 1, 171, 43, 18, 113, 134, 78, 9, 111, 107, 58, 106, 145, 160, 238, 140, 147, 232, 116, 52, 83, 158, 172, 190, 133, 121, 16, 139, 215, 102, 92, 90, 244, 142, 205, 49, 74, 129, 84, 162, 135, 49, 72, 198, 182, 17, 170, 87, 66, 212, 108, 11, 93, 211, 101, 39, 72, 250, 1, 238, 36, 149, 153, 48, 5, 77, 238, 254, 219, 90, 224, 71, 17, 15, 251, 85, 58, 170, 85, 235, 250, 68, 175, 137, 88, 163, 177, 153, 192, 134, 59, 115, 190, 244, 34, 19, 98, 94, 149, 195, 239, 153, 58, 152, 63, 167, 200, 38, 53, 220, 170, 154, 5, 46, 238, 54, 66, 152, 140, 225, 23, 102, 239, 163, 99, 195, 124, 222, 41, 33, 242, 13, 1, 1, 207, 251, 241, 74, 168, 252, 116, 254, 169, 244, 126, 132, 3, 164, 89, 104, 70, 157, 201, 98, 75, 208, 252, 83, 125, 135, 171, 62, 82, 31, 45, 233, 98, 94, 99, 204, 203, 154, 17, 242, 67, 101, 132, 207, 77, 192, 81, 248, 137, 139, 41, 140, 222, 133, 121, 68, 127, 219, 46, 166, 112, 47, 3, 120, 150, 111, 145, 59, 109, 121, 191, 182, 75, 67, 179, 125, 90, 101, 142, 7, 229, 152, 242, 249, 13, 250, 215, 99, 159, 129, 85, 125, 149, 192, 255, 111, 116, 4, 120, 105, 85, 199, 225, 251, 141, 111, 52, 13, 8, 44, 188, 116, 225, 101, 198, 216, 237, 45, 92, 177, 60, 219, 119, 97, 220, 106, 180, 116, 93, 242, 56, 238, 53, 209, 53, 226, 60, 131, 12, 10, 121, 210, 94, 23, 54, 141, 22, 229, 182, 198, 135, 54, 20, 55, 28, 124, 61, 45, 80, 18, 214, 225, 13, 38, 122, 214, 218, 33, 115, 47, 76, 90, 63, 32, 156, 171, 122, 226, 234, 69, 91, 3, 173, 183, 86, 185, 47, 246, 126, 54, 238, 245, 212, 118, 213, 201, 32, 76, 247, 86, 227, 168, 119, 80, 194, 51, 134, 45, 163, 252, 219, 220, 109, 84, 97, 86, 219, 130, 94, 254, 193, 219, 29, 34, 247, 204, 219, 12, 75, 228, 166, 152, 192, 149, 50, 47, 146, 238, 130, 147, 214, 14, 235, 206, 182, 96, 34, 86, 244, 127, 79, 1, 73, 81, 89, 189, 11, 212, 32, 218, 147, 168, 105, 21, 80, 89, 5, 169, 131, 131, 80, 152, 230, 92, 209, 170, 178, 170, 158, 209, 67, 217, 221, 168, 84, 109, 166, 206, 77, 182, 3, 59, 22, 63, 10, 38, 51, 175, 186, 140, 113, 38, 119, 19, 130, 62, 87, 22, 95, 28, 253, 211, 120, 182, 210, 118, 213, 249, 61, 87, 209, 205, 25, 172, 24, 57, 223, 200, 82, 88, 4, 113, 191, 79, 134, 76, 169, 10, 218, 159, 13, 216, 143, 204, 12, 134, 240, 244, 93, 211, 228, 247, 148, 134, 210, 42, 50, 220, 211, 62, 19, 37, 150, 93, 130, 18, 235, 118, 50, 151, 154, 69, 121, 106, 179, 61, 208, 27, 109, 250, 81, 234, 241, 81, 62, 246, 184, 175, 158, 191, 233, 182, 162, 52, 233, 172, 232, 159, 205, 164, 122, 109, 227, 255, 121, 191, 244, 120, 253, 251, 177, 107, 177, 46, 177, 143, 33, 224, 132, 110, 236, 110, 154, 87, 245, 16, 159, 12, 197, 14, 81, 208, 210, 131, 39, 71, 77, 32, 225, 20, 182, 161, 163, 177, 18, 149, 1, 90, 40, 8, 149, 159, 182, 81, 167, 246, 50, 88, 244, 237, 121, 142, 96, 215, 69, 126, 69, 254, 122, 94, 7, 145, 176, 198, 95, 93, 39, 166, 140, 161, 14, 148, 41, 119, 174, 163, 53, 134, 62, 126, 90, 72, 135, 23, 136, 104, 133, 239, 30, 23, 223, 67, 127, 40, 110, 139, 204, 87, 229, 249, 165, 191, 4, 170, 92, 97, 35, 101, 229, 136, 15, 45, 32, 106, 145, 150, 57, 128, 202, 66, 90, 78, 148, 43, 132, 132, 246, 20, 128, 191, 212, 172, 219, 243, 23, 36, 226, 199, 42, 66, 229, 13, 0, 56, 30, 39, 144, 78, 1, 152, 123, 66, 38, 71, 206, 170, 39, 243, 134, 31, 42, 219, 16, 232, 104, 110, 134, 100, 62, 10, 233, 148, 32, 190, 59, 134, 32, 131, 99, 133, 199, 95, 82, 81, 2, 5, 110, 140, 22, 11, 60, 151, 45, 172, 86, 198, 45, 93, 66, 150, 28, 103, 92, 115, 123, 126, 127, 194, 60, 237, 24, 226, 28, 245, 148, 243, 131, 181, 0
+        .quad .LBB0_0, .LBB0_1, .LBB0_2, .LBB0_3, .LBB0_4, .LBB0_5, .LBB0_6, .LBB0_7, .LBB0_8, .LBB0_9, .LBB0_10, .LBB0_11, .LBB0_12, .LBB0_13, .LBB0_14, .LBB0_15, .LBB0_16, .LBB0_17, .LBB0_18, .LBB0_19, .LBB0_20, .LBB0_21, .LBB0_22, .LBB0_23, .LBB0_24, .LBB0_25, .LBB0_26, .LBB0_27, .LBB0_28, .LBB0_29, .LBB0_30, .LBB0_31, .LBB0_32, .LBB0_33, .LBB0_34, .LBB0_35, .LBB0_36, .LBB0_37, .LBB0_38, .LBB0_39, .LBB0_40, .LBB0_41, .LBB0_42, .LBB0_43, .LBB0_44, .LBB0_45, .LBB0_46, .LBB0_47, .LBB0_48, .LBB0_49, .LBB0_50, .LBB0_51, .LBB0_52, .LBB0_53, .LBB0_54, .LBB0_55, .LBB0_56, .LBB0_57, .LBB0_58, .LBB0_59, .LBB0_60, .LBB0_61, .LBB0_62, .LBB0_63, .LBB0_64, .LBB0_65, .LBB0_66, .LBB0_67, .LBB0_68, .LBB0_69, .LBB0_70, .LBB0_71, .LBB0_72, .LBB0_73, .LBB0_74, .LBB0_75, .LBB0_76, .LBB0_77, .LBB0_78, .LBB0_79, .LBB0_80, .LBB0_81, .LBB0_82, .LBB0_83, .LBB0_84, .LBB0_85, .LBB0_86, .LBB0_87, .LBB0_88, .LBB0_89, .LBB0_90, .LBB0_91, .LBB0_92, .LBB0_93, .LBB0_94, .LBB0_95, .LBB0_96, .LBB0_97, .LBB0_98, .LBB0_99, .LBB0_100, .LBB0_101, .LBB0_102, .LBB0_103, .LBB0_104, .LBB0_105, .LBB0_106, .LBB0_107, .LBB0_108, .LBB0_109, .LBB0_110, .LBB0_111, .LBB0_112, .LBB0_113, .LBB0_114, .LBB0_115, .LBB0_116, .LBB0_117, .LBB0_118, .LBB0_119, .LBB0_120, .LBB0_121, .LBB0_122, .LBB0_123, .LBB0_124, .LBB0_125, .LBB0_126, .LBB0_127, .LBB0_128, .LBB0_129, .LBB0_130, .LBB0_131, .LBB0_132, .LBB0_133, .LBB0_134, .LBB0_135, .LBB0_136, .LBB0_137, .LBB0_138, .LBB0_139, .LBB0_140, .LBB0_141, .LBB0_142, .LBB0_143, .LBB0_144, .LBB0_145, .LBB0_146, .LBB0_147, .LBB0_148, .LBB0_149, .LBB0_150, .LBB0_151, .LBB0_152, .LBB0_153, .LBB0_154, .LBB0_155, .LBB0_156, .LBB0_157, .LBB0_158, .LBB0_159, .LBB0_160, .LBB0_161, .LBB0_162, .LBB0_163, .LBB0_164, .LBB0_165, .LBB0_166, .LBB0_167, .LBB0_168, .LBB0_169, .LBB0_170, .LBB0_171, .LBB0_172, .LBB0_173, .LBB0_174, .LBB0_175, .LBB0_176, .LBB0_177, .LBB0_178, .LBB0_179, .LBB0_180, .LBB0_181, .LBB0_182, .LBB0_183, .LBB0_184, .LBB0_185, .LBB0_186, .LBB0_187, .LBB0_188, .LBB0_189, .LBB0_190, .LBB0_191, .LBB0_192, .LBB0_193, .LBB0_194, .LBB0_195, .LBB0_196, .LBB0_197, .LBB0_198, .LBB0_199, .LBB0_200, .LBB0_201, .LBB0_202, .LBB0_203, .LBB0_204, .LBB0_205, .LBB0_206, .LBB0_207, .LBB0_208, .LBB0_209, .LBB0_210, .LBB0_211, .LBB0_212, .LBB0_213, .LBB0_214, .LBB0_215, .LBB0_216, .LBB0_217, .LBB0_218, .LBB0_219, .LBB0_220, .LBB0_221, .LBB0_222, .LBB0_223, .LBB0_224, .LBB0_225, .LBB0_226, .LBB0_227, .LBB0_228, .LBB0_229, .LBB0_230, .LBB0_231, .LBB0_232, .LBB0_233, .LBB0_234, .LBB0_235, .LBB0_236, .LBB0_237, .LBB0_238, .LBB0_239, .LBB0_240, .LBB0_241, .LBB0_242, .LBB0_243, .LBB0_244, .LBB0_245, .LBB0_246, .LBB0_247, .LBB0_248, .LBB0_249, .LBB0_250, .LBB0_251, .LBB0_252, .LBB0_253, .LBB0_254, .LBB0_255, .LBB0_256, .LBB0_257, .LBB0_258, .LBB0_259, .LBB0_260, .LBB0_261, .LBB0_262, .LBB0_263, .LBB0_264, .LBB0_265, .LBB0_266, .LBB0_267, .LBB0_268, .LBB0_269, .LBB0_270, .LBB0_271, .LBB0_272, .LBB0_273, .LBB0_274, .LBB0_275, .LBB0_276, .LBB0_277, .LBB0_278, .LBB0_279, .LBB0_280, .LBB0_281, .LBB0_282, .LBB0_283, .LBB0_284, .LBB0_285, .LBB0_286, .LBB0_287, .LBB0_288, .LBB0_289, .LBB0_290, .LBB0_291, .LBB0_292, .LBB0_293, .LBB0_294, .LBB0_295, .LBB0_296, .LBB0_297, .LBB0_298, .LBB0_299, .LBB0_300, .LBB0_301, .LBB0_302, .LBB0_303, .LBB0_304, .LBB0_305, .LBB0_306, .LBB0_307, .LBB0_308, .LBB0_309, .LBB0_310, .LBB0_311, .LBB0_312, .LBB0_313, .LBB0_314, .LBB0_315, .LBB0_316, .LBB0_317, .LBB0_318, .LBB0_319, .LBB0_320, .LBB0_321, .LBB0_322, .LBB0_323, .LBB0_324, .LBB0_325, .LBB0_326, .LBB0_327, .LBB0_328, .LBB0_0
+        movl    $0, %eax # do consectetur tempor elit eiusmod do adipiscing elit elit lorem eiusmod elit sit dolor adipiscing tempor adipiscing sit lorem dolor tempor do consectetur do amet sit eiusmod do dolor tempor lorem do amet sed amet elit eiusmod do sed sit sit sed adipiscing ipsum adipiscing ipsum tempor eiusmod adipiscing adipiscing ipsum do eiusmod dolor dolor adipiscing elit eiusmod sit tempor eiusmod amet tempor ipsum ipsum do do adipiscing do consectetur consectetur tempor sit tempor tempor tempor elit eiusmod lorem sed sit tempor sed ipsum amet dolor adipiscing lorem adipiscing dolor tempor sed elit sit ipsum dolor adipiscing dolor consectetur consectetur adipiscing eiusmod eiusmod sed sit amet lorem dolor dolor adipiscing sit sed sit sit do amet amet sit eiusmod ipsum tempor do sed do sed sit elit dolor ipsum adipiscing sed consectetur amet elit sit do sed elit adipiscing do sed ipsum consectetur elit lorem dolor amet eiusmod sit adipiscing ipsum consectetur adipiscing lorem tempor eiusmod tempor dolor do consectetur amet consectetur adipiscing eiusmod sit lorem tempor elit tempor sit sed sit ipsum ipsum adipiscing eiusmod eiusmod elit adipiscing lorem ipsum tempor elit amet lorem eiusmod adipiscing consectetur eiusmod sed tempor ipsum elit dolor ipsum ipsum sed dolor elit elit elit eiusmod sed amet adipiscing elit ipsum sit adipiscing dolor sed consectetur amet sit adipiscing ipsum eiusmod dolor adipiscing eiusmod ipsum elit consectetur eiusmod elit sed lorem amet sit amet amet eiusmod ipsum sit amet eiusmod consectetur dolor sed amet consectetur dolor amet amet elit elit adipiscing ipsum tempor eiusmod dolor ipsum adipiscing eiusmod sit lorem sit consectetur adipiscing adipiscing lorem adipiscing amet adipiscing ipsum dolor adipiscing adipiscing ipsum sit sed adipiscing adipiscing eiusmod amet ipsum tempor ipsum ipsum sit elit amet sit ipsum adipiscing dolor dolor amet dolor sit do consectetur amet consectetur adipiscing dolor sit sed dolor sit tempor tempor sit consectetur sed consectetur sed elit ipsum ipsum ipsum adipiscing elit adipiscing amet amet consectetur dolor lorem do do dolor consectetur amet eiusmod sit dolor ipsum ipsum adipiscing consectetur amet amet sit eiusmod tempor do elit elit dolor tempor lorem ipsum ipsum dolor lorem tempor lorem consectetur adipiscing dolor do sed lorem sit sed lorem dolor adipiscing ipsum consectetur consectetur eiusmod sed adipiscing sed consectetur eiusmod ipsum tempor dolor sit adipiscing do dolor eiusmod amet dolor adipiscing sit elit do amet sit sit consectetur do tempor adipiscing ipsum eiusmod lorem sed dolor amet do adipiscing tempor amet tempor amet dolor ipsum lorem lorem consectetur do ipsum amet consectetur tempor sed ipsum consectetur dolor sit do do sit do do lorem sit sed sed sed consectetur tempor sit do eiusmod eiusmod amet do eiusmod elit dolor elit dolor ipsum tempor elit do sit sit adipiscing dolor amet dolor adipiscing ipsum eiusmod sit sit eiusmod consectetur dolor consectetur amet eiusmod lorem ipsum lorem dolor amet do sed do consectetur tempor ipsum adipiscing eiusmod sed do dolor consectetur elit sed sed do sit eiusmod lorem amet tempor adipiscing eiusmod dolor sit elit amet consectetur sit tempor tempor dolor sit ipsum sed dolor ipsum dolor elit elit consectetur consectetur dolor sit sit amet adipiscing eiusmod dolor sit sed do ipsum do elit eiusmod elit adipiscing adipiscing elit elit tempor elit consectetur adipiscing dolor lorem do lorem adipiscing sed consectetur ipsum sed tempor 
+msg:    .ascii "amet tempor do do eiusmod amet adipiscing lorem amet tempor lorem elit elit consectetur lorem lorem lorem sed do eiusmod sed sed sit elit consectetur consectetur adipiscing elit tempor consectetur elit do sit ipsum do consectetur amet adipiscing adipiscing do sed amet consectetur do tempor tempor eiusmod consectetur do do sit dolor sed consectetur lorem lorem dolor lorem elit elit eiusmod do eiusmod dolor ipsum elit ipsum ipsum amet amet elit sit sed dolor sed eiusmod sed amet adipiscing consectetur amet adipiscing adipiscing sed amet tempor ipsum amet ipsum dolor do consectetur elit do lorem lorem consectetur consectetur eiusmod sed sed tempor do sed dolor amet tempor dolor elit lorem eiusmod consectetur ipsum do adipiscing sit sed ipsum dolor dolor ipsum dolor sit dolor eiusmod dolor sed sit dolor adipiscing do consectetur sed eiusmod adipiscing adipiscing amet elit eiusmod amet ipsum do lorem adipiscing dolor sed amet sit tempor adipiscing tempor adipiscing do dolor amet ipsum do tempor dolor amet sed ipsum ipsum ipsum adipiscing sit ipsum amet adipiscing sit adipiscing dolor do dolor amet sed dolor eiusmod do adipiscing consectetur ipsum adipiscing dolor adipiscing sed lorem tempor sit consectetur sit ipsum sit amet sit ipsum adipiscing elit dolor elit lorem amet sit adipiscing do dolor dolor ipsum lorem tempor eiusmod do tempor elit eiusmod sed amet ipsum ipsum tempor elit lorem elit dolor dolor do eiusmod eiusmod lorem elit dolor lorem consectetur ipsum eiusmod sit dolor do eiusmod adipiscing sit amet do ipsum amet sit tempor sed ipsum dolor do lorem do ipsum consectetur ipsum lorem adipiscing sed sed amet sed eiusmod tempor dolor sed amet lorem sed elit dolor sit eiusmod adipiscing consectetur ipsum consectetur adipiscing elit sit do do amet sed elit dolor adipiscing lorem amet consectetur tempor lorem tempor tempor lorem sit lorem do lorem ipsum eiusmod ipsum sit lorem adipiscing amet consectetur adipiscing tempor elit do do elit do adipiscing consectetur do amet dolor elit eiusmod do sit sed lorem dolor amet ipsum sit tempor eiusmod elit adipiscing ipsum sit eiusmod sed elit eiusmod sit lorem sed sed elit lorem tempor eiusmod elit elit amet amet sit amet do do do consectetur sit ipsum adipiscing sit consectetur adipiscing consectetur tempor ipsum consectetur elit tempor eiusmod do ipsum adipiscing ipsum elit tempor do elit eiusmod elit lorem elit amet consectetur lorem sed lorem sit ipsum consectetur elit sit eiusmod dolor ipsum elit ipsum sed sed dolor eiusmod ipsum lorem consectetur amet tempor do dolor eiusmod dolor tempor elit consectetur do consectetur amet eiusmod eiusmod do tempor eiusmod ipsum eiusmod ipsum lorem dolor eiusmod ipsum do tempor tempor ipsum tempor ipsum dolor do amet amet ipsum eiusmod sit sed elit amet tempor sed dolor lorem ipsum eiusmod do dolor dolor tempor sit adipiscing amet dolor sit sed dolor adipiscing ipsum consectetur do sed amet elit adipiscing do do ipsum tempor eiusmod adipiscing adipiscing do ipsum amet sed do ipsum sit do dolor elit sit ipsum consectetur sit ipsum consectetur lorem lorem amet eiusmod adipiscing eiusmod do elit lorem amet tempor ipsum consectetur ipsum eiusmod lorem adipiscing elit consectetur sed dolor amet lorem do consectetur do amet ipsum dolor amet sed consectetur elit amet consectetur tempor sed ipsum lorem adipiscing amet sed consectetur sit lorem eiusmod dolor dolor eiusmod sit sed consectetur adipiscing amet lorem dolor amet elit elit sit lorem ipsum amet amet elit "
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "edittrace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+
+static QString unescape(const QString &s, bool *ok)
+{
+    *ok = s.size() >= 2 && s.startsWith(QChar('"')) && s.endsWith(QChar('"'));
+    QString text;
+    for (int i = 1; *ok && i < s.size() - 1; ++i) {
+        QChar c = s.at(i);
+        if (c == QChar('\\')) {
+            if (++i == s.size() - 1) {
+                *ok = false;
+                break;
+            }
+            switch (s.at(i).unicode()) {
+            case 'n': c = QChar('\n'); break;
+            case 't': c = QChar('\t'); break;
+            case 'r': c = QChar('\r'); break;
+            case '"': c = QChar('"'); break;
+            case '\\': c = QChar('\\'); break;
+            default: *ok = false; break;
+            }
+        }
+        text.append(c);
+    }
+    return text;
+}
+
+static QString escape(const QString &text)
+{
+    QString s(QChar('"'));
+    for (const QChar c : text) {
+        switch (c.unicode()) {
+        case '\n': s.append(QStringLiteral("\\n")); break;
+        case '\t': s.append(QStringLiteral("\\t")); break;
+        case '\r': s.append(QStringLiteral("\\r")); break;
+        case '"': s.append(QStringLiteral("\\\"")); break;
+        case '\\': s.append(QStringLiteral("\\\\")); break;
+        default: s.append(c); break;
+        }
+    }
+    return s + QChar('"');
+}
+
+bool EditTrace::load(const QString &fileName, QString *error)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = f.errorString();
+        return false;
+    }
+
+    const QDir dir = QFileInfo(fileName).absoluteDir();
+    QTextStream in(&f);
+    for (int number = 1; !in.atEnd(); ++number) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith(QChar('#')))
+            continue;
+
+        const QStringList words = line.split(QRegularExpression(QStringLiteral("\\s+")));
+        const QString &directive = words.first();
+        bool ok = false;
+        if (directive == QLatin1String("language") && words.size() == 2) {
+            language = words.at(1);
+            ok = true;
+        } else if (directive == QLatin1String("document") && words.size() == 3) {
+            documentFile = dir.absoluteFilePath(words.at(1));
+            documentLines = words.at(2).toInt(&ok);
+        } else if (directive == QLatin1String("edit") && words.size() >= 4) {
+            Edit edit;
+            const QStringList position = words.at(1).split(QChar(':'));
+            bool positionOk = false, columnOk = true, textOk = false;
+            if (position.size() == 2) {
+                edit.line = position.first().toInt(&positionOk);
+                edit.position = position.last().toInt(&columnOk);
+                positionOk = positionOk && columnOk && edit.line > 0 && edit.position > 0;
+            } else {
+                edit.position = words.at(1).toInt(&positionOk);
+            }
+            edit.removed = words.at(2).toInt(&ok);
+            // the text may contain spaces, it is the rest of the line
+            const int start = line.indexOf(QChar('"'));
+            edit.inserted = unescape(start == -1 ? QString() : line.mid(start), &textOk);
+            ok = ok && positionOk && textOk && edit.removed >= 0;
+            if (ok)
+                edits.append(edit);
+        }
+        if (!ok) {
+            *error = QStringLiteral("line %1: can't parse \"%2\"").arg(number).arg(line);
+            return false;
+        }
+    }
+
+    if (language.isEmpty() || documentFile.isEmpty()) {
+        *error = QStringLiteral("no language or document");
+        return false;
+    }
+    return true;
+}
+
+bool EditTrace::save(const QString &fileName) const
+{
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&f);
+    out << "# recorded with qsourcehighlighter_bench --record\n";
+    out << "language " << language << '\n';
+    out << "document " << QFileInfo(fileName).absoluteDir().relativeFilePath(documentFile) << ' ' << documentLines << '\n';
+    for (const Edit &edit : edits) {
+        out << "edit ";
+        if (edit.line > 0)
+            out << edit.line << ':';
+        out << edit.position << ' ' << edit.removed << ' ' << escape(edit.inserted) << '\n';
+    }
+    out.flush();
+    return f.commit();
+}
+
+QString EditTrace::documentText() const
+{
+    QFile f(documentFile);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QString();
+    const QString text = QString::fromUtf8(f.readAll());
+    if (documentLines <= 0)
+        return text;
+
+    // like the demo, the lines of the file over and over
+    QStringList sample = text.split(QChar('\n'));
+    if (sample.size() > 1 && sample.last().isEmpty())
+        sample.removeLast();
+    QString repeated;
+    repeated.reserve(documentLines * 40);
+    for (int l = 0; l < documentLines; ++l) {
+        if (l > 0)
+            repeated.append(QChar('\n'));
+        repeated.append(sample.at(l % sample.size()));
+    }
+    return repeated;
+}
+
+int EditTrace::position(const Edit &edit, const QTextDocument *document)
+{
+    int position = edit.position;
+    if (edit.line > 0) {
+        const QTextBlock block = document->findBlockByNumber(edit.line - 1);
+        if (!block.isValid() || edit.position > block.length())
+            return -1;
+        position = block.position() + edit.position - 1;
+    }
+    const int end = document->characterCount() - 1;
+    return position >= 0 && position + edit.removed <= end ? position : -1;
+}
+
+EditTraceRecorder::EditTraceRecorder(QTextDocument *document, EditTrace *trace, QObject *parent)
+    : QObject(parent)
+    , _document(document)
+    , _trace(trace)
+    , _text(document->toPlainText())
+{
+    connect(document, &QTextDocument::contentsChange, this, &EditTraceRecorder::contentsChange);
+}
+
+void EditTraceRecorder::contentsChange(int position, int removed, int added)
+{
+    // the document reports the final paragraph separator in some ranges
+    removed = qMin(removed, _text.size() - position);
+    QTextCursor c(_document);
+    c.setPosition(position);
+    c.setPosition(qMin(position + added, _document->characterCount() - 1), QTextCursor::KeepAnchor);
+    const QString inserted = c.selectedText().replace(QChar::ParagraphSeparator, QChar('\n'));
+    const QString old = _text.mid(position, removed);
+    _text.replace(position, removed, inserted);
+
+    int prefix = 0;
+    while (prefix < old.size() && prefix < inserted.size() && old.at(prefix) == inserted.at(prefix))
+        ++prefix;
+    int suffix = 0;
+    while (suffix < old.size() - prefix && suffix < inserted.size() - prefix
+           && old.at(old.size() - 1 - suffix) == inserted.at(inserted.size() - 1 - suffix))
+        ++suffix;
+
+    EditTrace::Edit edit;
+    edit.position = position + prefix;
+    edit.removed = old.size() - prefix - suffix;
+    edit.inserted = inserted.mid(prefix, inserted.size() - prefix - suffix);
+    // format changes only
+    if (edit.removed > 0 || !edit.inserted.isEmpty())
+        _trace->edits.append(edit);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QTextDocument;
+
+/**
+ * @brief an editing session, as replayed by the benchmark
+ * @details Traces are text files, one directive per line, # starts a comment:
+ *
+ *     language cpp
+ *     document ../../test_files/C++.txt 20000
+ *     edit 100:1 0 "{"
+ *     edit 2417 2 ""
+ *
+ * The document is the file, relative to the trace, with its lines repeated
+ * to the given count, 0 keeps it as is. Each edit removes a number of chars
+ * at a position and inserts a text, with \n, \t, \r, \" and \\ escapes. The
+ * position is a document position, or line:column counted from 1.
+ */
+struct EditTrace
+{
+    struct Edit
+    {
+        int     line = 0;     // 0 if position is a document position
+        int     position = 0; // or the column
+        int     removed = 0;
+        QString inserted;
+    };
+
+    QString         language;
+    QString         documentFile;
+    int             documentLines = 0;
+    QVector<Edit>   edits;
+
+    bool load(const QString &fileName, QString *error);
+    bool save(const QString &fileName) const;
+    QString documentText() const;
+    /**
+     * @brief the document position of edit in document, -1 if it is outside
+     */
+    static int position(const Edit &edit, const QTextDocument *document);
+};
+
+/**
+ * @brief records the edits of document, e.g. typed in an editor, into trace
+ * @details The edits are reduced to the chars that really changed, the
+ * document reports larger ranges for some edits.
+ */
+class EditTraceRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    EditTraceRecorder(QTextDocument *document, EditTrace *trace, QObject *parent = nullptr);
+
+private:
+    void contentsChange(int position, int removed, int added);
+
+    QTextDocument *_document;
+    EditTrace     *_trace;
+    QString        _text; // of the document before the edit
+};
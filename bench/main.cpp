@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "edittrace.h"
+
+#include <qsourcehighlighter.h>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+/**
+ * @brief counts the blocks lexed, each edit lexes its blocks and the blocks
+ * after them as long as their start state changes
+ */
+class CountingHighlighter : public QSourceHighlighter
+{
+public:
+    using QSourceHighlighter::QSourceHighlighter;
+
+    int lexed = 0;
+
+protected:
+    void highlightBlock(const QString &text) override
+    {
+        ++lexed;
+        QSourceHighlighter::highlightBlock(text);
+    }
+};
+
+struct Result
+{
+    int lines = 0;
+    double loadMsecs = 0;
+    QVector<double> blocks; // lexed per edit
+    QVector<double> micros; // per edit
+    int worstEdit = -1;
+    int worstLine = 0;
+};
+
+/**
+ * @brief the p-quantile of values, by the nearest rank
+ */
+static double percentile(QVector<double> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const int rank = qBound(1, int(std::ceil(p * values.size())), values.size());
+    return values.at(rank - 1);
+}
+
+static double mean(const QVector<double> &values)
+{
+    return values.isEmpty() ? 0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+static bool replay(const EditTrace &trace, Result &result, QString *error)
+{
+    const QString text = trace.documentText();
+    if (text.isEmpty()) {
+        *error = QStringLiteral("can't read %1").arg(trace.documentFile);
+        return false;
+    }
+
+    QTextDocument document;
+    CountingHighlighter highlighter(&document);
+    if (!highlighter.setCurrentLanguage(trace.language)) {
+        *error = QStringLiteral("unknown language %1").arg(trace.language);
+        return false;
+    }
+
+    // the rehighlight QSyntaxHighlighter queues when attached, so the text is lexed once
+    QCoreApplication::processEvents();
+
+    QElapsedTimer clock;
+    clock.start();
+    document.setPlainText(text);
+    result.loadMsecs = clock.nsecsElapsed() / 1e6;
+    result.lines = document.blockCount();
+
+    for (int e = 0; e < trace.edits.size(); ++e) {
+        const EditTrace::Edit &edit = trace.edits.at(e);
+        const int position = EditTrace::position(edit, &document);
+        if (position == -1) {
+            *error = QStringLiteral("edit %1 is outside the document").arg(e + 1);
+            return false;
+        }
+
+        QTextCursor c(&document);
+        c.setPosition(position);
+        c.setPosition(position + edit.removed, QTextCursor::KeepAnchor);
+        highlighter.lexed = 0;
+        clock.start();
+        c.insertText(edit.inserted);
+        result.micros.append(clock.nsecsElapsed() / 1e3);
+        result.blocks.append(highlighter.lexed);
+
+        if (result.worstEdit == -1 || highlighter.lexed > result.blocks.at(result.worstEdit)) {
+            result.worstEdit = e;
+            result.worstLine = document.findBlock(position).blockNumber() + 1;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief open file in an editor and write the edits made to trace when it is closed
+ */
+static int record(QApplication &a, const QString &file, const QString &language, const QString &traceFile)
+{
+    EditTrace trace;
+    trace.language = language;
+    trace.documentFile = QFileInfo(file).absoluteFilePath();
+    const QString text = trace.documentText();
+    if (text.isEmpty()) {
+        qWarning("Can't read %s", qPrintable(file));
+        return 1;
+    }
+
+    QPlainTextEdit editor;
+    editor.setPlainText(text);
+    auto *highlighter = new QSourceHighlighter(editor.document());
+    highlighter->setCurrentLanguage(language);
+    EditTraceRecorder recorder(editor.document(), &trace);
+    editor.setWindowTitle(QStringLiteral("Recording %1").arg(traceFile));
+    editor.resize(900, 700);
+    editor.show();
+    a.exec();
+
+    if (!trace.save(traceFile)) {
+        qWarning("Can't write %s", qPrintable(traceFile));
+        return 1;
+    }
+    QTextStream(stdout) << trace.edits.size() << " edits written to " << traceFile << '\n';
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // replaying needs no display, recording opens an editor
+    bool recording = false;
+    for (int i = 1; i < argc; ++i)
+        recording = recording || qstrcmp(argv[i], "--record") == 0;
+    if (!recording && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication a(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("qsourcehighlighter_bench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Replays edit traces against a highlighted QTextDocument and reports the blocks lexed and the time per edit."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("traces"), QStringLiteral("Trace files, the bundled ones by default."), QStringLiteral("[traces...]"));
+    const QCommandLineOption csvOption(QStringLiteral("csv"), QStringLiteral("Append one row per trace to file."), QStringLiteral("file"));
+    const QCommandLineOption recordOption(QStringLiteral("record"), QStringLiteral("Edit the source file given as argument and record the edits to trace."), QStringLiteral("trace"));
+    const QCommandLineOption languageOption(QStringLiteral("language"), QStringLiteral("Language of the recorded file."), QStringLiteral("language"), QStringLiteral("cpp"));
+    parser.addOptions({csvOption, recordOption, languageOption});
+    parser.process(a);
+
+    if (parser.isSet(recordOption)) {
+        if (parser.positionalArguments().size() != 1)
+            parser.showHelp(1);
+        return record(a, parser.positionalArguments().first(), parser.value(languageOption), parser.value(recordOption));
+    }
+
+    QStringList traces = parser.positionalArguments();
+    if (traces.isEmpty()) {
+        const QDir bundled(QStringLiteral(QSOURCEHIGHLIGHTER_BENCH_TRACES));
+        for (const QString &name : bundled.entryList({QStringLiteral("*.trace")}, QDir::Files, QDir::Name))
+            traces.append(bundled.absoluteFilePath(name));
+    }
+
+    QFile csv(parser.value(csvOption));
+    QTextStream csvOut(&csv);
+    if (parser.isSet(csvOption)) {
+        const bool header = !csv.exists();
+        if (!csv.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            qWarning("Can't write %s", qPrintable(csv.fileName()));
+            return 1;
+        }
+        if (header)
+            csvOut << "trace,language,lines,edits,load_ms,blocks_total,blocks_mean,blocks_p50,blocks_p99,blocks_max,"
+                      "edit_us_mean,edit_us_p50,edit_us_p99,edit_us_max\n";
+    }
+
+    QTextStream out(stdout);
+    int failed = 0;
+    for (const QString &file : traces) {
+        const QString name = QFileInfo(file).completeBaseName();
+        EditTrace trace;
+        Result result;
+        QString error;
+        if (!trace.load(file, &error) || !replay(trace, result, &error)) {
+            qWarning("%s: %s", qPrintable(file), qPrintable(error));
+            ++failed;
+            continue;
+        }
+
+        const double total = std::accumulate(result.blocks.begin(), result.blocks.end(), 0.0);
+        const double maxBlocks = result.blocks.isEmpty() ? 0 : *std::max_element(result.blocks.begin(), result.blocks.end());
+        const double maxMicros = result.micros.isEmpty() ? 0 : *std::max_element(result.micros.begin(), result.micros.end());
+
+        out << name << " (" << trace.language << ", " << result.lines << " lines, "
+            << result.blocks.size() << " edits, loaded in " << QString::number(result.loadMsecs, 'f', 1) << " ms)\n";
+        out << "  blocks lexed per edit: mean " << QString::number(mean(result.blocks), 'f', 1)
+            << ", p50 " << percentile(result.blocks, 0.5) << ", p99 " << percentile(result.blocks, 0.99)
+            << ", max " << maxBlocks << ", total " << total << '\n';
+        out << "  time per edit (us):    mean " << QString::number(mean(result.micros), 'f', 1)
+            << ", p50 " << QString::number(percentile(result.micros, 0.5), 'f', 1)
+            << ", p99 " << QString::number(percentile(result.micros, 0.99), 'f', 1)
+            << ", max " << QString::number(maxMicros, 'f', 1) << '\n';
+        if (result.worstEdit != -1)
+            out << "  worst cascade: edit " << result.worstEdit + 1 << " on line " << result.worstLine
+                << ", " << result.blocks.at(result.worstEdit) << " blocks in "
+                << QString::number(result.micros.at(result.worstEdit) / 1e3, 'f', 2) << " ms\n";
+        out.flush();
+
+        if (csv.isOpen())
+            csvOut << name << ',' << trace.language << ',' << result.lines << ',' << result.blocks.size() << ','
+                   << result.loadMsecs << ',' << total << ',' << mean(result.blocks) << ','
+                   << percentile(result.blocks, 0.5) << ',' << percentile(result.blocks, 0.99) << ',' << maxBlocks << ','
+                   << mean(result.micros) << ',' << percentile(result.micros, 0.5) << ','
+                   << percentile(result.micros, 0.99) << ',' << maxMicros << '\n';
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <qsourcehighlightcache.h>
+#include <qsourcehighlightservice.h>
+
+#include <QCommandLineParser>
+#include <QGuiApplication>
+#include <QScopedPointer>
+
+int main(int argc, char *argv[])
+{
+    // QSyntaxHighlighter needs QtGui, but no display
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication a(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("qsourcehighlightd"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Highlights source files for the processes of the user."));
+    parser.addHelpOption();
+    const QCommandLineOption nameOption(QStringLiteral("name"), QStringLiteral("Socket name to listen on."), QStringLiteral("name"), QSourceHighlightServer::defaultName());
+    const QCommandLineOption sizeOption(QStringLiteral("cache-size"), QStringLiteral("MiB of results kept in memory."), QStringLiteral("MiB"), QStringLiteral("64"));
+    const QCommandLineOption diskOption(QStringLiteral("disk-cache"), QStringLiteral("Also keep the results in directory."), QStringLiteral("directory"));
+    parser.addOptions({nameOption, sizeOption, diskOption});
+    parser.process(a);
+
+    QSourceHighlightServer server;
+    server.setMaximumCacheSize(qBound(1, parser.value(sizeOption).toInt(), 1024) * 1024 * 1024);
+
+    QScopedPointer<QSourceHighlightCache> cache;
+    if (parser.isSet(diskOption)) {
+        cache.reset(new QSourceHighlightCache(parser.value(diskOption)));
+        server.setCache(cache.data());
+    }
+
+    if (!server.listen(parser.value(nameOption)))
+        return 1;
+    return a.exec();
+}
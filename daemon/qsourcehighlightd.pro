@@ -0,0 +1,13 @@
+QT       += core network
+
+# the highlighting service shared by the processes of a user
+TARGET = qsourcehighlightd
+
+CONFIG += c++11 console qsourcehighlighter_no_widgets qsourcehighlighter_service
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../QSourceHighlighter.pri)
+
+SOURCES += \
+    main.cpp
@@ -23,54 +23,360 @@
 #include <QDebug>
 
 #include "languagedata.h"
+#ifdef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+#include "languagetables.h"
+#endif
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QFile>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QJsonParseError>
-#include <QMultiHash>
+#include <QHash>
+#include <QMutexLocker>
 #include <QString>
+#include <QVariant>
+#include <QtConcurrent>
+#include <algorithm>
 
-ALanguage::ALanguage( const QString& Name, const QString& Def )
-    : comment( '/' )
+static qint64 now()
 {
-    static int idGen = 0;
-    name             = Name;
-    caseInsensitive  = false;
-    definitionName   = Def;
-    id               = idGen;
-    idGen += 3; // 1 for comment and 1 for multiline strings
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+int WordList::match( QStringView Text, int i, Qt::CaseSensitivity CS, bool ( *IsWordChar )( QChar ) ) const
+{
+    const quint16 First = ( CS == Qt::CaseInsensitive ) ? Text.at( i ).toLower().unicode() : Text.at( i ).unicode();
+    auto          It    = std::lower_bound( entries.cbegin(), entries.cend(), First, []( const Entry& E, quint16 C ) { return E.first < C; } );
+    // longest first, so a word that is a prefix of another one can't hide it
+    for ( ; It != entries.cend() && It->first == First; ++It )
+    {
+        const int End = i + It->length;
+        if ( End > Text.size() || ( End < Text.size() && IsWordChar( Text.at( End ) ) ) )
+            continue;
+        if ( Text.mid( i, It->length ).compare( QStringView( chars + It->offset, It->length ), CS ) == 0 )
+            return It->length;
+    }
+    return 0;
+}
+
+void WordList::build( const QChar* Pool, QVector< Entry >& Entries )
+{
+    std::sort( Entries.begin(), Entries.end(), []( const Entry& A, const Entry& B ) {
+        return ( A.first != B.first ) ? A.first < B.first : A.length > B.length;
+    } );
+    chars = Pool;
+    entries.clear();
+    entries.reserve( Entries.size() );
+    for ( const Entry& E : Entries )
+    {
+        // the same word twice in a category
+        if ( !entries.isEmpty() && entries.last().first == E.first && entries.last().length == E.length &&
+             QStringView( Pool + entries.last().offset, E.length ) == QStringView( Pool + E.offset, E.length ) )
+            continue;
+        entries.append( E );
+    }
+    entries.squeeze();
+}
+
+void WordList::clear()
+{
+    chars   = nullptr;
+    entries = QVector< Entry >();
+}
+
+qint64 WordList::bytesUsed() const
+{
+    return qint64( entries.capacity() ) * qint64( sizeof( Entry ) );
+}
+
+LanguageDefinition::LanguageDefinition( const QString& Name, const QString& File )
+    : name( Name )
+    , file( File )
+    , caseInsensitive( false )
+    , loaded( false )
+    , users( 0 )
+    , lastUsed( 0 )
+{ }
+
+LanguageDefinition::~LanguageDefinition()
+{
+    clearShards();
+}
+
+#ifdef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+static void loadTableWords( WordList& W, const char16_t* Pool, const LanguageWordList& L )
+{
+    QVector< WordList::Entry > Entries;
+    Entries.reserve( L.count );
+    for ( int I = 0; I < L.count; ++I )
+        Entries.append( WordList::Entry{ L.words[ I ].offset, L.words[ I ].length, quint16( Pool[ L.words[ I ].offset ] ) } );
+    // the pool is static data, the words point into it instead of copying it
+    W.build( reinterpret_cast< const QChar* >( Pool ), Entries );
+}
+
+const LanguageDefinitionTable* LanguageDefinition::table() const
+{
+    for ( int T = 0; T < LanguageDefinitionTableCount; ++T )
+    {
+        if ( name == QLatin1String( LanguageDefinitionTables[ T ].name ) )
+            return &LanguageDefinitionTables[ T ];
+    }
+    return nullptr;
+}
+
+void LanguageDefinition::loadTable( const LanguageDefinitionTable& T )
+{
+    comment             = QChar( T.comment );
+    multilinestringchar = QChar( T.multilinestringchar );
+    caseInsensitive     = T.caseInsensitive;
+    version             = QByteArray( T.version );
+
+    loadTableWords( types, T.pool, T.types );
+    loadTableWords( keywords, T.pool, T.keywords );
+    loadTableWords( builtin, T.pool, T.builtin );
+    loadTableWords( literals, T.pool, T.literals );
+    loadTableWords( others, T.pool, T.others );
+
+    for ( int S = 0; S < T.shardCount; ++S )
+    {
+        Shard* Sh  = new Shard;
+        Sh->name   = QString::fromLatin1( T.shards[ S ].name );
+        Sh->prefix = QString::fromLatin1( T.shards[ S ].prefix );
+        shards.append( Sh );
+    }
+}
+#endif
+
+void LanguageDefinition::ensureLoaded()
+{
+    if ( loaded )
+        return;
+
+    QMutexLocker Lock( &loadMutex );
+    if ( !loaded )
+    {
+        load();
+        // also after errors, a broken definition is reported once, not on every use
+        loaded = true;
+    }
+}
+
+void LanguageDefinition::acquire()
+{
+    // always under the mutex, unloadUnused() must see the user before it
+    // decides, or this must see that it was unloaded
+    QMutexLocker Lock( &loadMutex );
+    ++users;
+    if ( !loaded )
+    {
+        load();
+        loaded = true;
+    }
+}
+
+void LanguageDefinition::release()
+{
+    QMutexLocker Lock( &loadMutex );
+    --users;
+    lastUsed = now();
+}
+
+bool LanguageDefinition::unloadUnused( qint64 Msecs )
+{
+    QMutexLocker Lock( &loadMutex );
+    // builtin definitions without words, e.g. xml, can't be loaded again
+    if ( !loaded || users > 0 || now() - lastUsed < Msecs ||
+         ( types.isEmpty() && keywords.isEmpty() && builtin.isEmpty() && literals.isEmpty() && others.isEmpty() && shards.isEmpty() ) )
+        return false;
+
     loaded = false;
+    types.clear();
+    keywords.clear();
+    builtin.clear();
+    literals.clear();
+    others.clear();
+    pool = QString();
+    clearShards();
+    return true;
+}
+
+qint64 LanguageDefinition::bytesUsed()
+{
+    QMutexLocker Lock( &loadMutex );
+    if ( !loaded )
+        return 0;
+    qint64 Bytes = qint64( pool.capacity() ) * qint64( sizeof( QChar ) ) + types.bytesUsed() + keywords.bytesUsed() + builtin.bytesUsed() + literals.bytesUsed() +
+                   others.bytesUsed();
+    for ( const Shard* S : qAsConst( shards ) )
+    {
+        Bytes += S->json.capacity();
+        if ( !S->loaded )
+            continue;
+        Bytes += qint64( S->pool.capacity() ) * qint64( sizeof( QChar ) );
+        for ( const WordList& W : S->words )
+            Bytes += W.bytesUsed();
+    }
+    return Bytes;
+}
+
+int LanguageDefinition::match( Category C, QStringView Text, int i, Qt::CaseSensitivity CS, bool ( *IsWordChar )( QChar ), bool Shards ) const
+{
+    const WordList* Lists[] = { &types, &keywords, &builtin, &literals, &others };
+
+    int Length = Lists[ C ]->match( Text, i, CS, IsWordChar );
+    for ( int S = 0; Shards && Length == 0 && S < shards.size(); ++S )
+    {
+        if ( shards[ S ]->loaded.load( std::memory_order_acquire ) )
+            Length = shards[ S ]->words[ C ].match( Text, i, CS, IsWordChar );
+    }
+    return Length;
+}
+
+bool LanguageDefinition::loadShardFor( QStringView Word, Qt::CaseSensitivity CS )
+{
+    bool Loaded = false;
+    for ( Shard* S : qAsConst( shards ) )
+    {
+        if ( S->loaded.load( std::memory_order_acquire ) || !Word.startsWith( S->prefix, CS ) )
+            continue;
+
+        QMutexLocker Lock( &loadMutex );
+        if ( !S->loaded )
+        {
+            loadShardWords( S );
+            // also after errors, like the definition itself
+            S->loaded.store( true, std::memory_order_release );
+        }
+        // loaded by another thread meanwhile, the word is worth looking up again all the same
+        Loaded = true;
+    }
+    return Loaded;
+}
+
+bool LanguageDefinition::loadShard( const QString& Name )
+{
+    for ( Shard* S : qAsConst( shards ) )
+    {
+        if ( S->name != Name )
+            continue;
+
+        QMutexLocker Lock( &loadMutex );
+        if ( !S->loaded )
+        {
+            loadShardWords( S );
+            S->loaded.store( true, std::memory_order_release );
+        }
+        return true;
+    }
+    return false;
+}
+
+QStringList LanguageDefinition::shardNames() const
+{
+    QStringList Names;
+    for ( const Shard* S : shards )
+        Names.append( S->name );
+    return Names;
+}
+
+void LanguageDefinition::clearShards()
+{
+    qDeleteAll( shards );
+    shards.clear();
 }
 
-void ALanguage::loadToDictionary( ALanguage::wordDictionary& D, QVariantList VL )
+void LanguageDefinition::load()
 {
-    foreach ( auto V, VL )
+    lastUsed = now();
+    clearShards();
+
+#ifdef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+    if ( file.isEmpty() )
     {
-        D.insert( V.toString()[ 0 ].toLatin1(), V.toString() );
+        const LanguageDefinitionTable* T = table();
+        if ( T != nullptr )
+            loadTable( *T );
+        else
+            qWarning() << "No sourcehighlighter syntax table for" << name;
+        return;
     }
+#endif
+    loadJson( jsonFile() );
+}
+
+QString LanguageDefinition::jsonFile() const
+{
+    return file.isEmpty() ? QStringLiteral( ":/languages/language_%1.json" ).arg( name ) : file;
 }
 
-void ALanguage::load()
+static bool readJson( const QString& FileName, QByteArray& Data, QVariantMap& Defs )
 {
-    QFile F( QStringLiteral( ":/languages/language_%1.json" ).arg( definitionName ) );
+    QFile F( FileName );
 
     if ( !F.open( QIODevice::ReadOnly ) )
     {
         qWarning() << "Error loading sourcehighlighter syntax file" << F.fileName() << F.errorString();
-        return;
+        return false;
     }
 
     QJsonParseError Err;
-    QByteArray      FF = F.readAll();
-    QVariant        V  = QJsonDocument::fromJson( FF, &Err ).toVariant();
+    Data              = F.readAll();
+    const QVariant V = QJsonDocument::fromJson( Data, &Err ).toVariant();
 
     if ( Err.error != QJsonParseError::NoError )
     {
-        qWarning() << "Error loading sourcehighlighter syntax file" << F.fileName() << Err.errorString() << "near" << QString::fromUtf8( FF ).mid( qMax( 0, Err.offset - 10 ), 30 );
-        return;
+        qWarning() << "Error loading sourcehighlighter syntax file" << F.fileName() << Err.errorString() << "near" << QString::fromUtf8( Data ).mid( qMax( 0, Err.offset - 10 ), 30 );
+        return false;
     }
+    Defs = V.toMap();
+    return true;
+}
+
+/**
+ * @brief builds the word lists of the categories in Defs, the words go into
+ * one pool, a word in several categories only once
+ */
+static void loadJsonWords( const QVariantMap& Defs, QString& Pool, WordList* const ( &Lists )[ LanguageDefinition::CategoryCount ] )
+{
+    // the definition files use "other"
+    const QVariantList Categories[] = { Defs.value( "types" ).toList(), Defs.value( "keywords" ).toList(), Defs.value( "builtin" ).toList(),
+                                        Defs.value( "literals" ).toList(), Defs.value( Defs.contains( "others" ) ? "others" : "other" ).toList() };
+
+    QHash< QString, quint32 >  Offsets;
+    QVector< WordList::Entry > Entries[ LanguageDefinition::CategoryCount ];
+    Pool.clear();
+    for ( int C = 0; C < LanguageDefinition::CategoryCount; ++C )
+    {
+        for ( const QVariant& W : Categories[ C ] )
+        {
+            const QString Word = W.toString();
+            if ( Word.isEmpty() || Word.length() > 0xFFFF )
+                continue;
+            auto It = Offsets.constFind( Word );
+            if ( It == Offsets.constEnd() )
+            {
+                It = Offsets.insert( Word, quint32( Pool.length() ) );
+                Pool.append( Word );
+            }
+            Entries[ C ].append( WordList::Entry{ It.value(), quint16( Word.length() ), Word.at( 0 ).unicode() } );
+        }
+    }
+    Pool.squeeze();
+    for ( int C = 0; C < LanguageDefinition::CategoryCount; ++C )
+        Lists[ C ]->build( Pool.constData(), Entries[ C ] );
+}
+
+void LanguageDefinition::loadJson( const QString& FileName )
+{
+    QByteArray  FF;
+    QVariantMap Defs;
+    if ( !readJson( FileName, FF, Defs ) )
+        return;
+
+    version = QCryptographicHash::hash( FF, QCryptographicHash::Sha1 ).toHex().left( 16 );
 
     // load data
-    QVariantMap Defs = V.toMap();
     if ( Defs.contains( "comment" ) )
     {
         comment = Defs.value( "comment" ).toString().at( 0 );
@@ -81,18 +387,93 @@ void ALanguage::load()
     }
     caseInsensitive = Defs.value( "caseInsensitive", false ).toBool();
 
-    loadToDictionary( types, Defs.value( "types" ).toList() );
-    loadToDictionary( keywords, Defs.value( "keywords" ).toList() );
-    loadToDictionary( builtin, Defs.value( "builtin" ).toList() );
-    loadToDictionary( literals, Defs.value( "literals" ).toList() );
-    loadToDictionary( others, Defs.value( "others" ).toList() );
+    WordList* const Lists[] = { &types, &keywords, &builtin, &literals, &others };
+    loadJsonWords( Defs, pool, Lists );
+
+    // the words of the shards are only built when needed, until then they
+    // are kept as the JSON of the shard alone
+    for ( const QVariant& V : Defs.value( "shards" ).toList() )
+    {
+        const QVariantMap SD = V.toMap();
+        Shard*            S  = new Shard;
+        S->name              = SD.value( "name" ).toString();
+        S->prefix            = SD.value( "prefix" ).toString();
+        S->json              = QJsonDocument( QJsonObject::fromVariantMap( SD ) ).toJson( QJsonDocument::Compact );
+        shards.append( S );
+    }
+}
+
+/**
+ * @brief reads the words of shard S, with loadMutex held
+ */
+void LanguageDefinition::loadShardWords( Shard* S )
+{
+#ifdef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+    const LanguageDefinitionTable* T = file.isEmpty() ? table() : nullptr;
+    if ( T != nullptr )
+    {
+        for ( int I = 0; I < T->shardCount; ++I )
+        {
+            const LanguageShardTable& ST = T->shards[ I ];
+            if ( S->name != QLatin1String( ST.name ) )
+                continue;
+            loadTableWords( S->words[ Types ], T->pool, ST.types );
+            loadTableWords( S->words[ Keywords ], T->pool, ST.keywords );
+            loadTableWords( S->words[ Builtin ], T->pool, ST.builtin );
+            loadTableWords( S->words[ Literals ], T->pool, ST.literals );
+            loadTableWords( S->words[ Others ], T->pool, ST.others );
+        }
+        return;
+    }
+#endif
+
+    const QVariantMap SD = QJsonDocument::fromJson( S->json ).toVariant().toMap();
+    S->json              = QByteArray();
+    WordList* const Lists[] = { &S->words[ Types ], &S->words[ Keywords ], &S->words[ Builtin ], &S->words[ Literals ], &S->words[ Others ] };
+    loadJsonWords( SD, S->pool, Lists );
+}
+
+ALanguage::ALanguage( const QString& Name, LanguageDefinition* Def )
+{
+    static int idGen = 0;
+    name             = Name;
+    definition       = Def;
+    id               = idGen;
+    idGen += StateCount;
+}
+
+LanguageDefinition* LanguageDB::definition( const QString& Name, const QString& File )
+{
+    const QString       Key = File.isEmpty() ? Name : File;
+    LanguageDefinition* D   = Definitions.value( Key );
+    if ( D == nullptr )
+    {
+        D                   = new LanguageDefinition( Name, File );
+        Definitions[ Key ] = D;
+    }
+    return D;
 }
 
 LanguageDB::LanguageDB()
 {
+#ifdef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+    for ( int T = 0; T < LanguageTableCount; ++T )
+    {
+        const LanguageTable& LT  = LanguageTables[ T ];
+        const QString        Key = QString::fromLatin1( LT.name );
+        Languages[ Key ]         = new ALanguage( Key, definition( QString::fromLatin1( LT.definitionName ) ) );
+        for ( int E = 0; E < LT.extensionCount; ++E )
+        {
+            Extensions[ QString::fromLatin1( LT.extensions[ E ] ) ] = Languages[ Key ];
+        }
+    }
+#else
     QFile F( ":/languages/languages.json" );
 
-    Q_ASSERT( F.open( QIODevice::ReadOnly ) );
+    // open outside of Q_ASSERT, which is compiled out in release builds
+    const bool Opened = F.open( QIODevice::ReadOnly );
+    Q_ASSERT( Opened );
+    Q_UNUSED( Opened );
 
     QJsonParseError Err;
     QByteArray      FF = F.readAll();
@@ -108,17 +489,20 @@ LanguageDB::LanguageDB()
     while ( MI.hasNext() )
     {
         MI.next();
-        Languages[ MI.key() ] = new ALanguage( MI.key(), MI.value().toMap()[ "name" ].toString() );
+        Languages[ MI.key() ] = new ALanguage( MI.key(), definition( MI.value().toMap()[ "name" ].toString() ) );
         foreach ( auto V, MI.value().toMap()[ "extensions" ].toStringList() )
         {
             Extensions[ V ] = Languages[ MI.key() ];
         }
     }
+#endif
 
     // add builtin language XML
-    Languages[ "xml" ]  = new ALanguage( "xml", "xml" );
+    Languages[ "xml" ]  = new ALanguage( "xml", definition( "xml" ) );
     Extensions[ "xml" ] = Languages[ "xml" ];
-    Languages[ "xml" ]->loaded = true;
+    for ( const char* Markup : { "html", "htm", "xhtml", "svg", "ui", "qrc", "xsd", "xsl" } )
+        Extensions[ Markup ] = Languages[ "xml" ];
+    Languages[ "xml" ]->definition->loaded = true;
 }
 
 LanguageDB::~LanguageDB()
@@ -133,11 +517,74 @@ ALanguage* LanguageDB::language( const QString& Language )
         return L;
     }
 
-    if ( !L->loaded )
+    L->ensureLoaded();
+
+    return L;
+}
+
+ALanguage* LanguageDB::find( const QString& Language ) const
+{
+    return Languages.value( Language );
+}
+
+QFuture< void > LanguageDB::preload( const QStringList& Names )
+{
+    QList< LanguageDefinition* > Todo;
+    foreach ( auto N, Names.isEmpty() ? Languages.keys() : Names )
+    {
+        ALanguage* L = Languages.value( N );
+        if ( L != nullptr && !L->definition->loaded && !Todo.contains( L->definition ) )
+        {
+            Todo.append( L->definition );
+        }
+    }
+
+    // one task per definition, so they load in parallel and each one can be
+    // used as soon as it is ready
+    QList< QFuture< void > > Futures;
+    for ( LanguageDefinition* D : Todo )
+    {
+        D->loading = QtConcurrent::run( [ D ]() { D->ensureLoaded(); } );
+        Futures.append( D->loading );
+    }
+
+    return QtConcurrent::run( [ Futures ]() {
+        for ( QFuture< void > F : Futures )
+        {
+            F.waitForFinished();
+        }
+    } );
+}
+
+ALanguage* LanguageDB::addLanguage( const QString& Name, const QString& DefinitionFile, const QStringList& Exts )
+{
+    ALanguage* L      = new ALanguage( Name, definition( Name, DefinitionFile ) );
+    Languages[ Name ] = L;
+    foreach ( auto E, Exts )
+    {
+        Extensions[ E ] = L;
+    }
+    return L;
+}
+
+int LanguageDB::unloadUnused( qint64 Msecs )
+{
+    int Unloaded = 0;
+    for ( LanguageDefinition* D : qAsConst( Definitions ) )
     {
-        L->load();
+        if ( D->unloadUnused( Msecs ) )
+            ++Unloaded;
     }
+    return Unloaded;
+}
 
+ALanguage* LanguageDB::findByExtension( const QString& Ext ) const
+{
+    ALanguage* L = Extensions.value( Ext );
+    if ( L == nullptr )
+    {
+        qWarning() << "No syntax file for extension" << Ext;
+    }
     return L;
 }
 
@@ -149,10 +596,7 @@ ALanguage* LanguageDB::languageByExtension( const QString& Ext )
         qWarning() << "No syntax file for extension" << Ext;
         return L;
     }
-    if ( !L->loaded )
-    {
-        L->load();
-    }
+    L->ensureLoaded();
 
     return L;
 }
@@ -23,37 +23,193 @@
 
 #pragma once
 
+#include <QByteArray>
+#include <QFuture>
 #include <QMap>
-#include <QMultiHash>
+#include <QMutex>
 #include <QString>
-#include <QVariantMap>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+#include <atomic>
 
 class QLatin1String;
+struct LanguageDefinitionTable;
+struct LanguageShardTable;
+struct LanguageWordList;
 
-struct ALanguage
+/**
+ * @brief the words of one category of a definition, e.g. its keywords
+ * @details The words are views into the string pool of the definition,
+ * sorted by their first char so the candidates for a position are found
+ * with a binary search instead of one heap allocated string per word.
+ */
+class WordList
 {
-    using wordDictionary = QMultiHash< QChar, QString >;
+public:
+    struct Entry
+    {
+        quint32 offset; // into the pool
+        quint16 length;
+        quint16 first; // first char, the sort key
+    };
 
-    ALanguage( const QString& Name, const QString& Def );
+    /**
+     * @brief length of the word of the list at position i of Text, 0 if none
+     * @param CS case sensitivity of the comparison, words of case insensitive
+     * languages are lower case
+     * @param IsWordChar tells if the char after a match continues the word
+     */
+    int match( QStringView Text, int i, Qt::CaseSensitivity CS, bool ( *IsWordChar )( QChar ) ) const;
 
-    void load();
+    void build( const QChar* Pool, QVector< Entry >& Entries );
+    void clear();
+    Q_REQUIRED_RESULT bool   isEmpty() const { return entries.isEmpty(); }
+    Q_REQUIRED_RESULT qint64 bytesUsed() const;
+
+private:
+    const QChar*     chars = nullptr;
+    QVector< Entry > entries;
+};
+
+/**
+ * @brief a language definition, shared by the languages using it, e.g. c and cpp
+ * @details Loaded on first use and unloaded again by unloadUnused() when no
+ * highlighter has used it for a while. Large definitions keep the words of
+ * their dialects, e.g. the AVX instructions of asm, in shards that are only
+ * loaded once a word of theirs is missed or a dialect is asked for.
+ */
+struct LanguageDefinition
+{
+    enum Category
+    {
+        Types,
+        Keywords,
+        Builtin,
+        Literals,
+        Others,
+        CategoryCount
+    };
+
+    /**
+     * @brief the words of a dialect, all starting with prefix
+     */
+    struct Shard
+    {
+        QString name;
+        QString prefix;
+        // set once the words are complete, they are read only afterwards
+        std::atomic< bool > loaded{ false };
+        WordList            words[ CategoryCount ];
+        // the words of JSON shards, static tables have their own pool
+        QString pool;
+        // the shard in compact JSON until its words are loaded, the
+        // definition file is only parsed once
+        QByteArray json;
+    };
+
+    LanguageDefinition( const QString& Name, const QString& File = QString() );
+    ~LanguageDefinition();
+
+    /**
+     * @brief loads the definition unless it is loaded already
+     * @details safe to call from several threads, the others wait for the first
+     */
+    void ensureLoaded();
+    /**
+     * @brief ensureLoaded() for a highlighter, which uses the definition
+     * until it calls release(). A definition in use is never unloaded.
+     */
+    void acquire();
+    void release();
+    /**
+     * @brief frees the words unless the definition is in use or was used
+     * less than Msecs ago
+     * @returns true if it was unloaded
+     */
+    bool unloadUnused( qint64 Msecs );
+    /**
+     * @brief heap memory used by the definition, 0 while it isn't loaded
+     */
+    Q_REQUIRED_RESULT qint64 bytesUsed();
+
+    /**
+     * @brief WordList::match() on the words of Category
+     * @param Shards also the words of the loaded shards, e.g. for an instruction
+     */
+    int match( Category C, QStringView Text, int i, Qt::CaseSensitivity CS, bool ( *IsWordChar )( QChar ), bool Shards ) const;
+    /**
+     * @brief loads the shards whose prefix Word starts with, after it was not found
+     * @returns true if one was loaded, so Word is worth looking up again
+     */
+    bool loadShardFor( QStringView Word, Qt::CaseSensitivity CS );
+    /**
+     * @brief loads the shard of dialect Name, e.g. when a detector found it
+     * @returns false if the definition has no such shard
+     */
+    bool                           loadShard( const QString& Name );
+    Q_REQUIRED_RESULT QStringList shardNames() const;
 
     QString name;
-    QString definitionName;
-    int     id;
-    bool    caseInsensitive;
-    bool    loaded;
+    QString file; // user supplied JSON definition, empty for builtin ones
+    // hash of the definition, changes whenever the definition does
+    QByteArray version;
+    bool       caseInsensitive;
+    // set once the words are complete, they are read only afterwards
+    std::atomic< bool > loaded;
+    // running background load started by LanguageDB::preload()
+    QFuture< void > loading;
 
-    QChar          comment;
-    QChar          multilinestringchar;
-    wordDictionary types;
-    wordDictionary keywords;
-    wordDictionary builtin;
-    wordDictionary literals;
-    wordDictionary others;
+    QChar    comment; // null for C style // and /* */ comments
+    QChar    multilinestringchar;
+    WordList types;
+    WordList keywords;
+    WordList builtin;
+    WordList literals;
+    WordList others;
+    // created with their name and prefix by the load, before loaded is set
+    QVector< Shard* > shards;
 
-    private:
-    void loadToDictionary(wordDictionary& D, QVariantList VL );
+private:
+    QMutex loadMutex;
+    // highlighters using the definition, and when the last one stopped
+    int    users;
+    qint64 lastUsed;
+    // the words of JSON definitions, static tables have their own pool
+    QString pool;
+
+    void load();
+    void loadJson( const QString& FileName );
+    void loadShardWords( Shard* S );
+    void clearShards();
+    Q_REQUIRED_RESULT QString jsonFile() const;
+#ifdef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
+    void loadTable( const LanguageDefinitionTable& T );
+    Q_REQUIRED_RESULT const LanguageDefinitionTable* table() const;
+#endif
+};
+
+struct ALanguage
+{
+    // block states of a language are id + mode: code, comment and multi-line
+    // string for most languages, more for xml, see QSourceHighlighter::XmlMode
+    enum
+    {
+        StateCount = 8
+    };
+
+    ALanguage( const QString& Name, LanguageDefinition* Def );
+
+    void ensureLoaded()
+    {
+        definition->ensureLoaded();
+    }
+
+    QString name;
+    int     id;
+    // builtin languages share one definition when they use the same one
+    LanguageDefinition* definition;
 };
 
 class LanguageDB
@@ -66,10 +222,40 @@ class LanguageDB
 
     ALanguage* operator[]( const QString& Language );
 
+    /**
+     * @brief the language named Language, without loading it
+     */
+    ALanguage* find( const QString& Language ) const;
+    ALanguage* findByExtension( const QString& Ext ) const;
+
+    /**
+     * @brief loads languages on a worker thread
+     * @param Names the languages to load, all of them if empty
+     * @returns a future that finishes once all of them are loaded
+     */
+    QFuture< void > preload( const QStringList& Names );
+
     void load();
 
+    /**
+     * @brief register a language defined in a JSON file in the format of
+     * languages/language_*.json, replacing any language with that name
+     */
+    ALanguage* addLanguage( const QString& Name, const QString& DefinitionFile, const QStringList& Exts );
+
+    /**
+     * @brief unloads the definitions not used for Msecs
+     * @returns the number of definitions unloaded
+     */
+    int unloadUnused( qint64 Msecs );
+
     public:
     QMap< QString, ALanguage* > Extensions;
     QMap< QString, ALanguage* > Languages;
+    // by definition name, or by file for user supplied definitions
+    QMap< QString, LanguageDefinition* > Definitions;
     ALanguage*                  languageByExtension( const QString& Ext );
+
+    private:
+    LanguageDefinition* definition( const QString& Name, const QString& File = QString() );
 };
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+/*
+ * Static language tables generated by tools/generate_languages.py
+ * when building with CONFIG += qsourcehighlighter_static_languages
+ */
+
+struct LanguageWord
+{
+    quint32 offset; // into the pool of the definition
+    quint16 length;
+};
+
+struct LanguageWordList
+{
+    const LanguageWord* words; // sorted
+    int                 count;
+};
+
+struct LanguageShardTable
+{
+    const char*      name;
+    const char*      prefix; // see LanguageDefinition::Shard
+    LanguageWordList types;
+    LanguageWordList keywords;
+    LanguageWordList builtin;
+    LanguageWordList literals;
+    LanguageWordList others;
+};
+
+struct LanguageDefinitionTable
+{
+    const char*      name;
+    const char*      version; // see LanguageDefinition::version
+    char16_t         comment;
+    char16_t         multilinestringchar;
+    bool             caseInsensitive;
+    const char16_t*  pool; // all the words of the definition and its shards, back to back
+    LanguageWordList types;
+    LanguageWordList keywords;
+    LanguageWordList builtin;
+    LanguageWordList literals;
+    LanguageWordList          others;
+    const LanguageShardTable* shards;
+    int                       shardCount;
+};
+
+struct LanguageTable
+{
+    const char*        name;
+    const char*        definitionName;
+    const char* const* extensions;
+    int                extensionCount;
+};
+
+extern const LanguageDefinitionTable LanguageDefinitionTables[];
+extern const int                     LanguageDefinitionTableCount;
+extern const LanguageTable           LanguageTables[];
+extern const int                     LanguageTableCount;
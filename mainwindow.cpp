@@ -27,16 +27,25 @@
 
 #include <QDebug>
 #include <QDir>
-
-QHash<QString, QSourceHighlighter::Language> MainWindow::_langStringToEnum;
+#include <QFile>
+#include <QFontDatabase>
+#include <QRandomGenerator>
+#include <QScrollBar>
+#include <QTextStream>
+#include <QtTest/QTest>
+#include <algorithm>
+#include <cmath>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , _phase(Idle)
+    , _waiting(false)
+    , _steps(0)
+    , _droppedFrames(0)
 {
     ui->setupUi(this);
 
-    initLangsEnum();
     initLangsComboBox();
     initThemesComboBox();
 
@@ -45,16 +54,21 @@ MainWindow::MainWindow(QWidget *parent)
     ui->plainTextEdit->setFont(f);
     highlighter = new QSourceHighlighter(ui->plainTextEdit->document());
 
-    connect(ui->langComboBox,
-            static_cast<void (QComboBox::*) (const QString&)>(&QComboBox::currentIndexChanged),
-            this, &MainWindow::languageChanged);
+    // about 60 frames per second
+    _scrollTimer.setInterval(16);
+    connect(&_scrollTimer, &QTimer::timeout, this, &MainWindow::scrollStep);
+
+    connect(ui->langComboBox, &QComboBox::currentTextChanged, this, &MainWindow::languageChanged);
     connect(ui->themeComboBox,
             static_cast<void (QComboBox::*) (int)>(&QComboBox::currentIndexChanged),
             this, &MainWindow::themeChanged);
+    connect(ui->backgroundCheckBox, &QCheckBox::toggled, highlighter, &QSourceHighlighter::setBackgroundLexing);
+    connect(ui->generateButton, &QPushButton::clicked, this, &MainWindow::generateDocument);
+    connect(ui->runButton, &QPushButton::clicked, this, &MainWindow::runStress);
+    connect(ui->plainTextEdit, &StressEdit::painted, this, &MainWindow::painted);
 
-    ui->langComboBox->setCurrentText("Asm");
-    languageChanged("Asm");
-    //    connect(ui->plainTextEdit, &QPlainTextEdit::textChanged, this, &MainWindow::printDebug);
+    // asm, the first language, is selected already and selecting it again emits nothing
+    languageChanged(ui->langComboBox->currentText());
 }
 
 MainWindow::~MainWindow()
@@ -62,82 +76,213 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-void MainWindow::initLangsEnum()
-{
-    MainWindow::_langStringToEnum = QHash<QString, QSourceHighlighter::Language> {
-        { QLatin1String("Asm"), QSourceHighlighter::CodeAsm },
-        { QLatin1String("Bash"), QSourceHighlighter::CodeBash },
-        { QLatin1String("C"), QSourceHighlighter::CodeC },
-        { QLatin1String("C++"), QSourceHighlighter::CodeCpp },
-        { QLatin1String("CMake"), QSourceHighlighter::CodeCMake },
-        { QLatin1String("CSharp"), QSourceHighlighter::CodeCSharp },
-        { QLatin1String("Css"), QSourceHighlighter::CodeCSS },
-        { QLatin1String("Go"), QSourceHighlighter::CodeGo },
-        { QLatin1String("Html"), QSourceHighlighter::CodeXML },
-        { QLatin1String("Ini"), QSourceHighlighter::CodeINI },
-        { QLatin1String("Java"), QSourceHighlighter::CodeJava },
-        { QLatin1String("Javascript"), QSourceHighlighter::CodeJava },
-        { QLatin1String("Json"), QSourceHighlighter::CodeJSON },
-        { QLatin1String("Lua"), QSourceHighlighter::CodeLua },
-        { QLatin1String("Make"), QSourceHighlighter::CodeMake },
-        { QLatin1String("Php"), QSourceHighlighter::CodePHP },
-        { QLatin1String("Python"), QSourceHighlighter::CodePython },
-        { QLatin1String("Qml"), QSourceHighlighter::CodeQML },
-        { QLatin1String("Rust"), QSourceHighlighter::CodeRust },
-        { QLatin1String("Sql"), QSourceHighlighter::CodeSQL },
-        { QLatin1String("Typescript"), QSourceHighlighter::CodeTypeScript },
-        { QLatin1String("V"), QSourceHighlighter::CodeV },
-        { QLatin1String("Vex"), QSourceHighlighter::CodeVex },
-        { QLatin1String("Xml"), QSourceHighlighter::CodeXML },
-        { QLatin1String("Yaml"), QSourceHighlighter::CodeYAML }
-    };
-}
-
 void MainWindow::initThemesComboBox()
 {
-    ui->themeComboBox->addItem("Monokai", QSourceHighlighter::Themes::Monokai);
-    ui->themeComboBox->addItem("debug", QSourceHighlighter::Themes::Monokai);
+    ui->themeComboBox->addItem("Default", QString());
+    ui->themeComboBox->addItem("Monokai", QStringLiteral("monokai"));
 }
 
 void MainWindow::initLangsComboBox() {
-    ui->langComboBox->addItem("Asm");
-    ui->langComboBox->addItem("Bash");
-    ui->langComboBox->addItem("C");
-    ui->langComboBox->addItem("C++");
-    ui->langComboBox->addItem("CMake");
-    ui->langComboBox->addItem("CSharp");
-    ui->langComboBox->addItem("Css");
-    ui->langComboBox->addItem("Go");
-    ui->langComboBox->addItem("Html");
-    ui->langComboBox->addItem("Ini");
-    ui->langComboBox->addItem("Javascript");
-    ui->langComboBox->addItem("Java");
-    ui->langComboBox->addItem("Lua");
-    ui->langComboBox->addItem("Make");
-    ui->langComboBox->addItem("Php");
-    ui->langComboBox->addItem("Python");
-    ui->langComboBox->addItem("Qml");
-    ui->langComboBox->addItem("Rust");
-    ui->langComboBox->addItem("Sql");
-    ui->langComboBox->addItem("Typescript");
-    ui->langComboBox->addItem("V");
-    ui->langComboBox->addItem("Vex");
-    ui->langComboBox->addItem("Xml");
-    ui->langComboBox->addItem("Yaml");
+    // as in languages/languages.json, plus the builtin xml
+    const char* const languages[] = { "asm", "c", "cmake", "cpp", "csharp", "css", "go", "java", "js", "json", "lua",
+                                      "make", "php", "py", "qml", "rs", "sh", "sql", "ts", "v", "vex", "xml", "yaml" };
+    for (const char* language : languages)
+        ui->langComboBox->addItem(QString::fromLatin1(language));
 }
 
 void MainWindow::themeChanged(int) {
-    QSourceHighlighter::Themes theme = (QSourceHighlighter::Themes)ui->themeComboBox->currentData().toInt();
-    highlighter->setTheme(theme);
+    highlighter->applyTheme(ui->themeComboBox->currentData().toString());
 }
 
 void MainWindow::languageChanged(const QString &lang) {
-    highlighter->setCurrentLanguage(_langStringToEnum.value(lang));
+    highlighter->setCurrentLanguage(lang);
+    ui->plainTextEdit->setPlainText(sampleText(lang));
+}
+
+/**
+ * @brief the sample of test_files/ for lang, or a generic one
+ */
+QString MainWindow::sampleText(const QString &lang) const
+{
+    static const QHash<QString, QString> samples {
+        { "asm", "Asm" }, { "c", "C" }, { "cmake", "CMake" }, { "cpp", "C++" },
+        { "csharp", "CSharp" }, { "css", "Css" }, { "go", "Go" }, { "java", "Java" },
+        { "js", "JavaScript" }, { "json", "Json" }, { "lua", "Lua" }, { "make", "Make" },
+        { "php", "Php" }, { "py", "Python" }, { "qml", "Qml" }, { "rs", "Rust" },
+        { "sh", "Shell" }, { "sql", "Sql" }, { "ts", "TypeScript" }, { "v", "V" },
+        { "vex", "Vex" }, { "xml", "Xml" }, { "yaml", "Yaml" }
+    };
+
+    QFile f(QDir::currentPath() + "/../test_files/" + samples.value(lang, lang) + ".txt");
+    if (f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QString::fromUtf8(f.readAll());
+
+    // comments, strings and numbers, so edits change the block states
+    return QStringLiteral("/* a comment\n"
+                          "   spanning lines */\n"
+                          "int main(int argc, char *argv[]) {\n"
+                          "    const char *s = \"a string\"; // a line comment\n"
+                          "    return argc > 1 ? 0x1F : 42;\n"
+                          "}\n");
+}
+
+/**
+ * @brief fill the editor with the sample repeated to the chosen line count
+ */
+void MainWindow::generateDocument()
+{
+    const QStringList sample = sampleText(ui->langComboBox->currentText()).split(QChar('\n'));
+    const int lines = ui->linesSpinBox->value();
+
+    QString text;
+    text.reserve(lines * 40);
+    for (int l = 0; l < lines; ++l) {
+        if (l > 0)
+            text.append(QChar('\n'));
+        text.append(sample.at(l % sample.size()));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    ui->plainTextEdit->setPlainText(text);
+    ui->resultsLabel->setText(tr("%1 lines set in %2 ms").arg(lines).arg(timer.elapsed()));
+}
+
+void MainWindow::runStress()
+{
+    if (_phase != Idle)
+        return;
+
+    _keyLatencies.clear();
+    _frameTimes.clear();
+    _droppedFrames = 0;
+    ui->runButton->setEnabled(false);
+    ui->plainTextEdit->setFocus();
+
+    _phase = Typing;
+    _steps = ui->keystrokesSpinBox->value();
+    nextKeystroke();
+}
+
+/**
+ * @brief type a char at a random position, the clock runs until it is painted
+ * @details Quotes and comment markers are typed too, they change the
+ * state of the following blocks like real edits do.
+ */
+void MainWindow::nextKeystroke()
+{
+    if (_steps-- <= 0) {
+        startScrolling();
+        return;
+    }
+
+    static const char keys[] = "abcxyz _(){};\"/*0";
+    QRandomGenerator *random = QRandomGenerator::global();
+    QTextDocument *doc = ui->plainTextEdit->document();
+
+    const QTextBlock block = doc->findBlockByNumber(random->bounded(doc->blockCount()));
+    QTextCursor cursor(block);
+    cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, random->bounded(block.length()));
+    ui->plainTextEdit->setTextCursor(cursor);
+    // the jump to the position is painted before the clock starts
+    ui->plainTextEdit->viewport()->repaint();
+
+    const char key = keys[random->bounded(int(sizeof(keys)) - 1)];
+    _waiting = true;
+    _clock.start();
+    QTest::keyClick(ui->plainTextEdit, key);
+    // a key the editor ignores would otherwise stall the run
+    ui->plainTextEdit->viewport()->update();
+}
+
+void MainWindow::startScrolling()
+{
+    _phase = Scrolling;
+    _steps = ui->framesSpinBox->value();
+    ui->plainTextEdit->verticalScrollBar()->setValue(0);
+    _waiting = false;
+    _scrollTimer.start();
+}
+
+/**
+ * @brief scroll by the chosen number of lines, the clock runs until the
+ * frame is painted
+ */
+void MainWindow::scrollStep()
+{
+    QScrollBar *bar = ui->plainTextEdit->verticalScrollBar();
+    if (_steps-- <= 0 || bar->value() == bar->maximum()) {
+        _scrollTimer.stop();
+        finishRun();
+        return;
+    }
+    if (_waiting)
+        ++_droppedFrames;
+
+    _waiting = true;
+    _clock.start();
+    bar->setValue(bar->value() + ui->scrollSpinBox->value());
+}
+
+void MainWindow::painted()
+{
+    if (!_waiting)
+        return;
+    _waiting = false;
+
+    const double msecs = _clock.nsecsElapsed() / 1e6;
+    if (_phase == Typing) {
+        _keyLatencies.append(msecs);
+        QTimer::singleShot(ui->typingSpinBox->value(), this, &MainWindow::nextKeystroke);
+    } else if (_phase == Scrolling) {
+        _frameTimes.append(msecs);
+    }
+}
+
+void MainWindow::finishRun()
+{
+    _phase = Idle;
+    ui->runButton->setEnabled(true);
+
+    const QString language = ui->langComboBox->currentText();
+    const int lines = ui->plainTextEdit->document()->blockCount();
+    const bool background = highlighter->backgroundLexing();
+    const double keyP50 = percentile(_keyLatencies, 0.5);
+    const double keyP99 = percentile(_keyLatencies, 0.99);
+    const double frameP50 = percentile(_frameTimes, 0.5);
+    const double frameP99 = percentile(_frameTimes, 0.99);
 
-    QFile f(QDir::currentPath() + "/../test_files/" + lang + ".txt");
-    if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        const auto text = f.readAll();
-        ui->plainTextEdit->setPlainText(QString::fromUtf8(text));
+    ui->resultsLabel->setText(tr("%1, %2 lines\n"
+                                 "keystroke to paint: p50 %3 ms, p99 %4 ms\n"
+                                 "scroll frames: p50 %5 ms, p99 %6 ms, %7 dropped")
+                                  .arg(language).arg(lines)
+                                  .arg(keyP50, 0, 'f', 2).arg(keyP99, 0, 'f', 2)
+                                  .arg(frameP50, 0, 'f', 2).arg(frameP99, 0, 'f', 2)
+                                  .arg(_droppedFrames));
+
+    // one row per run, to compare engine changes
+    QFile f(QStringLiteral("stress_results.csv"));
+    const bool header = !f.exists();
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "Can't record the results in" << f.fileName() << f.errorString();
+        return;
     }
-    f.close();
+    QTextStream out(&f);
+    if (header)
+        out << "language,lines,background,keystrokes,key_p50_ms,key_p99_ms,frames,frame_p50_ms,frame_p99_ms,dropped\n";
+    out << language << ',' << lines << ',' << int(background) << ','
+        << _keyLatencies.size() << ',' << keyP50 << ',' << keyP99 << ','
+        << _frameTimes.size() << ',' << frameP50 << ',' << frameP99 << ',' << _droppedFrames << '\n';
+}
+
+/**
+ * @brief the p-quantile of values, by the nearest rank
+ */
+double MainWindow::percentile(QVector<double> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const int rank = qBound(1, int(std::ceil(p * values.size())), values.size());
+    return values.at(rank - 1);
 }
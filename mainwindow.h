@@ -23,13 +23,51 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QMainWindow>
+#include <QPlainTextEdit>
+#include <QTimer>
+#include <QVector>
 #include <qsourcehighlighter.h>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+/**
+ * @brief QPlainTextEdit telling when it finished painting, for the latency
+ * measurements of the stress mode
+ */
+class StressEdit : public QPlainTextEdit
+{
+    Q_OBJECT
+
+public:
+    explicit StressEdit( QWidget* parent = nullptr )
+        : QPlainTextEdit( parent )
+    {
+    }
+
+signals:
+    void painted();
+
+protected:
+    void paintEvent( QPaintEvent* event ) override
+    {
+        QPlainTextEdit::paintEvent( event );
+        emit painted();
+    }
+};
+
+/**
+ * @brief the demo, and a stress harness for the engine
+ * @details "Generate" fills the editor with a document of the chosen
+ * number of lines in the chosen language. "Run" then types at random
+ * positions with QTest key events, measuring each keystroke until the
+ * editor painted it, and scrolls through the document at a fixed rate,
+ * measuring each frame until it painted. The p50 and p99 of both are shown
+ * and appended to stress_results.csv in the working directory.
+ */
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -39,18 +77,39 @@ public:
     ~MainWindow();
 
 private:
+    enum Phase
+    {
+        Idle,
+        Typing,
+        Scrolling
+    };
+
     Ui::MainWindow *ui;
     QSourceHighlighter *highlighter;
-    static QHash<QString, QSourceHighlighter::Language> _langStringToEnum;
+
+    Phase           _phase;
+    QElapsedTimer   _clock;   // since the keystroke or the scroll step
+    bool            _waiting; // for the paint of _clock
+    int             _steps;   // keystrokes or frames left
+    QTimer          _scrollTimer;
+    QVector<double> _keyLatencies; // msecs
+    QVector<double> _frameTimes;
+    int             _droppedFrames; // steps that came before the previous frame painted
 
     /* FUNCTIONS */
-    void initLangsEnum();
     void initLangsComboBox();
     void initThemesComboBox();
+    QString sampleText(const QString &lang) const;
+    void nextKeystroke();
+    void startScrolling();
+    void finishRun();
+    static double percentile(QVector<double> values, double p);
 
 private slots:
     void themeChanged(int);
     void languageChanged(const QString &lang);
-
+    void generateDocument();
+    void runStress();
+    void painted();
+    void scrollStep();
 };
-#endif // MAINWINDOW_H
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "qsourcebatchhighlighter.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent>
+#include <atomic>
+#include <deque>
+
+namespace
+{
+typedef QSourceHighlighter::Span Span;
+
+/**
+ * @brief consecutive lines of a file, lexed by one task
+ */
+struct Chunk
+{
+    int firstLine = 0;
+    int lineCount = 0;
+    // state each line starts in, plus the state after the last line
+    QVector< int > states;
+    // index of the first span of each line, plus spans.size()
+    QVector< int >  lineSpans;
+    QVector< Span > spans;
+    bool            done = false;
+};
+
+struct File
+{
+    int     job;
+    QString path;
+    QString language;
+    QString text;
+    // position of each line, plus text.length() + 1
+    QVector< int >   lineStarts;
+    QVector< Chunk > chunks;
+
+    // protects done and confirming, the chunks are confirmed by one
+    // worker at a time which owns confirmed and state meanwhile
+    QMutex mutex;
+    int    confirmed  = 0;
+    int    state      = -1;
+    bool   confirming = false;
+};
+
+struct Task
+{
+    File* file;
+    int   chunk; // -1 loads the file
+};
+
+struct Queue
+{
+    QMutex             mutex;
+    std::deque< Task > tasks;
+};
+
+class Batch
+{
+public:
+    Batch( int Threads, int ChunkLines, const QSourceBatchHighlighter::Callback& Callback )
+        : chunkLines( ChunkLines )
+        , callback( Callback )
+        , outstanding( 0 )
+        , queued( 0 )
+    {
+        for ( int W = 0; W < Threads; ++W )
+            queues.append( new Queue );
+    }
+
+    ~Batch()
+    {
+        qDeleteAll( queues );
+        qDeleteAll( files );
+    }
+
+    void addJob( int Job, const QSourceBatchHighlighter::Job& J )
+    {
+        File* F     = new File;
+        F->job      = Job;
+        F->path     = J.path;
+        F->text     = J.text;
+        F->language = J.language;
+        files.append( F );
+        push( Job % queues.size(), Task{ F, -1 } );
+    }
+
+    void run( int Worker );
+
+private:
+    void push( int Worker, const Task& T )
+    {
+        ++outstanding;
+        // before the task can be popped, queued never goes below 0
+        ++queued;
+        {
+            QMutexLocker Lock( &queues[ Worker ]->mutex );
+            queues[ Worker ]->tasks.push_back( T );
+        }
+        QMutexLocker Lock( &idleMutex );
+        wakeUp.wakeOne();
+    }
+
+    bool pop( int Worker, Task& T );
+    void load( QSourceHighlighter& H, File* F, int Worker );
+    void lex( QSourceHighlighter& H, File* F, Chunk& C, int State );
+    void relex( QSourceHighlighter& H, File* F, Chunk& C, int State );
+    void confirm( QSourceHighlighter& H, File* F, int Chunk );
+
+    const int                                chunkLines;
+    const QSourceBatchHighlighter::Callback& callback;
+    QVector< Queue* >                        queues;
+    QVector< File* >                         files;
+    // tasks queued or running, the workers stop when it drops to 0
+    std::atomic< int > outstanding;
+    // tasks in the queues, idle workers sleep while there are none
+    std::atomic< int > queued;
+    QMutex             idleMutex;
+    QWaitCondition     wakeUp;
+};
+
+/**
+ * @brief line L of F without its line break, sharing the data of F->text
+ */
+static QString lineText( const File* F, int L )
+{
+    const int Start = F->lineStarts[ L ];
+    int       End   = F->lineStarts[ L + 1 ] - 1;
+    if ( End > Start && F->text.at( End - 1 ) == QChar( '\r' ) )
+        --End;
+    return QString::fromRawData( F->text.constData() + Start, End - Start );
+}
+
+/**
+ * @brief take a task, from the back of the own queue or else from the
+ * front of another worker's queue
+ */
+bool Batch::pop( int Worker, Task& T )
+{
+    {
+        Queue*       Q = queues[ Worker ];
+        QMutexLocker Lock( &Q->mutex );
+        if ( !Q->tasks.empty() )
+        {
+            T = Q->tasks.back();
+            Q->tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+
+    for ( int I = 1; I < queues.size(); ++I )
+    {
+        Queue*       Q = queues[ ( Worker + I ) % queues.size() ];
+        QMutexLocker Lock( &Q->mutex );
+        if ( !Q->tasks.empty() )
+        {
+            T = Q->tasks.front();
+            Q->tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Batch::run( int Worker )
+{
+    // created on the worker thread, highlightLine() isn't reentrant
+    QSourceHighlighter H( nullptr );
+    Task               T;
+
+    while ( outstanding.load() > 0 )
+    {
+        if ( !pop( Worker, T ) )
+        {
+            // the remaining tasks are running elsewhere and may still add
+            // chunks, push() wakes one worker per task and the last task all of them
+            QMutexLocker Lock( &idleMutex );
+            while ( outstanding.load() > 0 && queued.load() == 0 )
+                wakeUp.wait( &idleMutex );
+            continue;
+        }
+
+        if ( T.chunk == -1 )
+        {
+            load( H, T.file, Worker );
+        } else
+        {
+            H.setCurrentLanguage( T.file->language );
+            // speculatively assume the chunk starts outside of comments and strings
+            lex( H, T.file, T.file->chunks[ T.chunk ], H.initialState() );
+            confirm( H, T.file, T.chunk );
+        }
+        if ( --outstanding == 0 )
+        {
+            QMutexLocker Lock( &idleMutex );
+            wakeUp.wakeAll();
+        }
+    }
+}
+
+/**
+ * @brief read the file and split it into lines, and into chunks if it is large
+ */
+void Batch::load( QSourceHighlighter& H, File* F, int Worker )
+{
+    if ( F->text.isEmpty() && !F->path.isEmpty() )
+    {
+        QFile Source( F->path );
+        if ( Source.open( QIODevice::ReadOnly ) )
+            F->text = QString::fromUtf8( Source.readAll() );
+    }
+    if ( F->language.isEmpty() )
+        F->language = QSourceHighlighter::languageForFile( F->path );
+
+    if ( F->language.isEmpty() || !H.setCurrentLanguage( F->language ) )
+    {
+        callback( F->job, QVector< Span >(), true );
+        return;
+    }
+
+    F->lineStarts.append( 0 );
+    const QChar* Data = F->text.constData();
+    for ( int I = 0; I < F->text.length(); ++I )
+    {
+        if ( Data[ I ] == QChar( '\n' ) )
+            F->lineStarts.append( I + 1 );
+    }
+    const int Lines = F->lineStarts.size();
+    F->lineStarts.append( F->text.length() + 1 );
+
+    const int Chunks = ( Lines + chunkLines - 1 ) / chunkLines;
+    F->chunks.resize( Chunks );
+    for ( int I = 0; I < Chunks; ++I )
+    {
+        F->chunks[ I ].firstLine = I * chunkLines;
+        F->chunks[ I ].lineCount = qMin( chunkLines, Lines - I * chunkLines );
+    }
+    F->state = H.initialState();
+
+    // the first chunk is lexed here, the worker then continues with the
+    // second one from the back of its queue while the others steal the last ones
+    for ( int I = Chunks - 1; I > 0; --I )
+        push( Worker, Task{ F, I } );
+
+    lex( H, F, F->chunks[ 0 ], F->state );
+    confirm( H, F, 0 );
+}
+
+void Batch::lex( QSourceHighlighter& H, File* F, Chunk& C, int State )
+{
+    C.states.resize( C.lineCount + 1 );
+    C.lineSpans.resize( C.lineCount + 1 );
+    C.spans.clear();
+
+    for ( int I = 0; I < C.lineCount; ++I )
+    {
+        const int L      = C.firstLine + I;
+        C.states[ I ]    = State;
+        C.lineSpans[ I ] = C.spans.size();
+        State            = H.highlightLine( lineText( F, L ), State, C.spans, F->lineStarts[ L ] );
+    }
+    C.states[ C.lineCount ]    = State;
+    C.lineSpans[ C.lineCount ] = C.spans.size();
+}
+
+/**
+ * @brief lex C again starting in State, until a line is entered with the
+ * same state as in the first run, from there on the first run is kept
+ */
+void Batch::relex( QSourceHighlighter& H, File* F, Chunk& C, int State )
+{
+    QVector< Span > Spans;
+    for ( int I = 0; I < C.lineCount; ++I )
+    {
+        if ( I > 0 && State == C.states[ I ] )
+        {
+            for ( int S = C.lineSpans[ I ]; S < C.spans.size(); ++S )
+                Spans.append( C.spans.at( S ) );
+            C.spans.swap( Spans );
+            return;
+        }
+
+        const int L = C.firstLine + I;
+        State       = H.highlightLine( lineText( F, L ), State, Spans, F->lineStarts[ L ] );
+    }
+    C.spans.swap( Spans );
+    C.states[ C.lineCount ] = State;
+}
+
+/**
+ * @brief mark chunk Index as lexed and deliver the chunks that are complete
+ * @details Whoever finds the file unconfirmed delivers all chunks that are
+ * done, in order, without holding the mutex while relexing or calling back.
+ */
+void Batch::confirm( QSourceHighlighter& H, File* F, int Index )
+{
+    QMutexLocker Lock( &F->mutex );
+    F->chunks[ Index ].done = true;
+    if ( F->confirming )
+        return;
+    F->confirming = true;
+
+    while ( F->confirmed < F->chunks.size() && F->chunks[ F->confirmed ].done )
+    {
+        Chunk&     C    = F->chunks[ F->confirmed ];
+        const bool Last = F->confirmed + 1 == F->chunks.size();
+        Lock.unlock();
+
+        if ( C.states.first() != F->state )
+            relex( H, F, C, F->state );
+        F->state = C.states.last();
+        callback( F->job, C.spans, Last );
+        C.spans     = QVector< Span >();
+        C.states    = QVector< int >();
+        C.lineSpans = QVector< int >();
+
+        Lock.relock();
+        ++F->confirmed;
+    }
+    F->confirming = false;
+}
+} // namespace
+
+QSourceBatchHighlighter::QSourceBatchHighlighter( int threads )
+    : _threads( ( threads > 0 ) ? threads : qMax( 1, QThread::idealThreadCount() ) )
+    , _chunkLines( 2000 )
+{
+}
+
+void QSourceBatchHighlighter::setChunkLines( int lines )
+{
+    _chunkLines = qMax( 1, lines );
+}
+
+int QSourceBatchHighlighter::chunkLines() const
+{
+    return _chunkLines;
+}
+
+void QSourceBatchHighlighter::highlight( const QVector< Job >& jobs, const Callback& callback )
+{
+    if ( jobs.isEmpty() )
+        return;
+
+    {
+        // the language database and the themes are created by the first
+        // highlighter, make sure that happens before the workers start
+        QSourceHighlighter Primer( nullptr );
+    }
+
+    const int Threads = qMin( _threads, jobs.size() * 4 );
+    Batch     B( Threads, _chunkLines, callback );
+    for ( int J = 0; J < jobs.size(); ++J )
+        B.addJob( J, jobs.at( J ) );
+
+    QThreadPool Pool;
+    Pool.setMaxThreadCount( Threads );
+    QVector< QFuture< void > > Workers;
+    for ( int W = 0; W < Threads; ++W )
+        Workers.append( QtConcurrent::run( &Pool, [ &B, W ]() { B.run( W ); } ) );
+    for ( auto& Worker : Workers )
+        Worker.waitForFinished();
+}
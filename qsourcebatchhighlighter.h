@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "qsourcehighlighter.h"
+
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+/**
+ * @brief Highlights many files at once without documents, e.g. for indexing
+ * or exporting a whole source tree
+ * @details Every worker thread has its own QSourceHighlighter and its own
+ * task queue. Workers take tasks from the back of their own queue and steal
+ * from the front of the others, so a few large files don't leave threads idle.
+ * Large files are split into chunks of lines which are lexed in parallel,
+ * assuming they start outside of comments and strings. Chunks are confirmed
+ * in order: a chunk that was entered with another state is lexed again until
+ * its states agree with the first run, which usually happens after a line.
+ */
+class QSOURCEHIGHLIGHTER_EXPORT QSourceBatchHighlighter
+{
+public:
+    struct Job
+    {
+        QString path;     // read if text is empty, its suffix selects the language
+        QString text;     // the content, used instead of reading path
+        QString language; // overrides the language found from path
+    };
+
+    /**
+     * @brief receives the spans of consecutive lines of a job
+     * @param job index of the job
+     * @param spans the spans, with positions in the text of the job
+     * @param last true for the last call of the job
+     * @details Called on the worker threads. The calls for one job are in
+     * document order and never concurrent, calls for different jobs may be.
+     * Jobs that can't be read or have no language get a single empty call.
+     */
+    typedef std::function< void( int job, const QVector< QSourceHighlighter::Span >& spans, bool last ) > Callback;
+
+    /**
+     * @param threads number of worker threads, 0 for one per core
+     */
+    explicit QSourceBatchHighlighter( int threads = 0 );
+
+    /**
+     * @brief lines per chunk, files with more lines are split
+     */
+    void setChunkLines( int lines );
+    Q_REQUIRED_RESULT int chunkLines() const;
+
+    /**
+     * @brief highlights all jobs and returns when they are done
+     */
+    void highlight( const QVector< Job >& jobs, const Callback& callback );
+
+private:
+    int _threads;
+    int _chunkLines;
+};
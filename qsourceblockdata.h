@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QVector>
+
+#include <algorithm>
+#include <climits>
+
+struct QSourceBlockData;
+
+/**
+ * @brief the blocks each identifier occurs in, keyed by the hash of the identifier
+ * @details Kept up to date by QSourceHighlighter as it lexes blocks, and by
+ * the blocks themselves when they are deleted, see QSourceHighlighter::occurrences().
+ */
+class QSourceIdentifierIndex
+{
+public:
+    void insert( uint Hash, QSourceBlockData* Block )
+    {
+        blocks[ Hash ].insert( Block );
+    }
+
+    void remove( uint Hash, QSourceBlockData* Block )
+    {
+        auto It = blocks.find( Hash );
+        if ( It == blocks.end() )
+            return;
+        It->remove( Block );
+        if ( It->isEmpty() )
+            blocks.erase( It );
+    }
+
+    QSet< QSourceBlockData* > find( uint Hash ) const
+    {
+        return blocks.value( Hash );
+    }
+
+    int identifierCount() const
+    {
+        return blocks.size();
+    }
+
+private:
+    QHash< uint, QSet< QSourceBlockData* > > blocks;
+};
+
+/**
+ * @brief Per block information collected by QSourceHighlighter while lexing
+ * @details Everything stored here only depends on the text of the block and
+ * the state it was entered with, so it is rebuilt whenever QSyntaxHighlighter
+ * re-highlights the block and never needs a document wide pass.
+ */
+struct QSourceBlockData : public QTextBlockUserData
+{
+    enum BracketKind
+    {
+        Paren,
+        Square,
+        Curly,
+        BracketKindCount
+    };
+
+    struct Symbol
+    {
+        int position; // relative to the start of the block
+        int length;
+        int kind; // QSourceHighlighter::SymbolKind
+
+        bool operator==( const Symbol& O ) const
+        {
+            return position == O.position && length == O.length && kind == O.kind;
+        }
+        bool operator!=( const Symbol& O ) const
+        {
+            return !( *this == O );
+        }
+    };
+
+    struct Identifier
+    {
+        int  position; // relative to the start of the block
+        int  length;
+        uint hash; // qHash() of the identifier
+    };
+
+    struct Bracket
+    {
+        int         position; // relative to the start of the block
+        BracketKind kind;
+        bool        open;
+    };
+
+    /**
+     * @brief where lexing of a long line can resume, see QSourceHighlighter::setLongLineLimits()
+     */
+    struct Checkpoint
+    {
+        int  position;     // loop position in the block
+        int  state;        // block state at position
+        uint hash;         // of the text since the previous checkpoint, plus a margin
+        int  firstFormat;  // formats and contexts recorded before position
+        int  firstContext;
+        int  formatEnd;    // end of the formats before position, the lexer looks ahead a little
+    };
+
+    struct Format
+    {
+        int     start;
+        int     length;
+        quint8  token;     // QSourceHighlighter::Token
+        quint8  modifiers; // QSourceHighlighter::FormatModifier
+        quint32 color;
+    };
+
+    struct Context
+    {
+        int start;
+        int end;
+        int token; // QSourceHighlighter::Token
+    };
+
+    /**
+     * @brief a semantic token over the lexical formats, see QSourceHighlighter::setSemanticTokens()
+     */
+    struct Overlay
+    {
+        int start; // relative to the start of the block
+        int end;
+        int type;
+    };
+
+    /**
+     * @brief the overlays of a block, sorted by start
+     * @details The implicit binary tree over the sorted array keeps the
+     * largest end of each subtree, so the overlays overlapping a range are
+     * found without visiting the others.
+     */
+    class OverlayTree
+    {
+    public:
+        void assign( QVector< Overlay > Overlays )
+        {
+            std::sort( Overlays.begin(), Overlays.end(), []( const Overlay& A, const Overlay& B ) { return A.start < B.start; } );
+            items.swap( Overlays );
+            maxEnd.resize( items.size() );
+            build( 0, items.size() );
+        }
+
+        void clear()
+        {
+            items.clear();
+            maxEnd.clear();
+        }
+
+        bool isEmpty() const
+        {
+            return items.isEmpty();
+        }
+
+        const QVector< Overlay >& overlays() const
+        {
+            return items;
+        }
+
+        /**
+         * @brief calls F for each overlay overlapping Start to End, in order
+         */
+        template< typename Fn >
+        void overlapping( int Start, int End, Fn F ) const
+        {
+            query( 0, items.size(), Start, End, F );
+        }
+
+    private:
+        int build( int Lo, int Hi )
+        {
+            if ( Lo >= Hi )
+                return INT_MIN;
+            const int Mid = ( Lo + Hi ) / 2;
+            maxEnd[ Mid ] = qMax( items[ Mid ].end, qMax( build( Lo, Mid ), build( Mid + 1, Hi ) ) );
+            return maxEnd[ Mid ];
+        }
+
+        template< typename Fn >
+        void query( int Lo, int Hi, int Start, int End, Fn& F ) const
+        {
+            if ( Lo >= Hi )
+                return;
+            const int Mid = ( Lo + Hi ) / 2;
+            if ( maxEnd[ Mid ] <= Start )
+                return;
+            query( Lo, Mid, Start, End, F );
+            if ( items[ Mid ].start >= End )
+                return;
+            if ( items[ Mid ].end > Start )
+                F( items[ Mid ] );
+            query( Mid + 1, Hi, Start, End, F );
+        }
+
+        QVector< Overlay > items;
+        QVector< int >     maxEnd; // of the subtree under each item
+    };
+
+    /**
+     * @brief returns the kind of the bracket c
+     * @param c the char being checked
+     * @param open set to true if c is an opening bracket
+     * @returns the bracket kind or BracketKindCount if c is not a bracket
+     */
+    static inline BracketKind bracketKind( const QChar c, bool& open )
+    {
+        switch ( c.unicode() )
+        {
+            case '(': open = true; return Paren;
+            case ')': open = false; return Paren;
+            case '[': open = true; return Square;
+            case ']': open = false; return Square;
+            case '{': open = true; return Curly;
+            case '}': open = false; return Curly;
+            default: return BracketKindCount;
+        }
+    }
+
+    ~QSourceBlockData() override
+    {
+        unindexIdentifiers();
+    }
+
+    void clear()
+    {
+        brackets.clear();
+        identifiers.clear();
+        symbols.clear();
+        for ( int K = 0; K < BracketKindCount; ++K )
+        {
+            depthDelta[ K ] = 0;
+            minDepth[ K ]   = 0;
+        }
+        foldDelta = 0;
+        foldMin   = 0;
+        indent    = -1;
+        checkpoints.clear();
+        formats.clear();
+        contexts.clear();
+    }
+
+    void addBracket( int Pos, BracketKind K, bool Open )
+    {
+        brackets.append( Bracket{ Pos, K, Open } );
+        depthDelta[ K ] += Open ? 1 : -1;
+        minDepth[ K ] = qMin( minDepth[ K ], depthDelta[ K ] );
+    }
+
+    /**
+     * @brief list the block under its identifiers in Index, after removing
+     * it from the index it was listed in before
+     */
+    void indexIdentifiers( const QSharedPointer< QSourceIdentifierIndex >& Index, const QVector< Identifier >& Previous )
+    {
+        const QSharedPointer< QSourceIdentifierIndex > Old = identifierIndex.toStrongRef();
+        const auto SameHash = []( const Identifier& A, const Identifier& B ) { return A.hash == B.hash; };
+        // most blocks are lexed again with the same identifiers, only moved
+        if ( Old == Index && Previous.size() == identifiers.size() && std::equal( Previous.cbegin(), Previous.cend(), identifiers.cbegin(), SameHash ) )
+            return;
+
+        if ( Old != nullptr )
+        {
+            for ( const Identifier& I : Previous )
+                Old->remove( I.hash, this );
+        }
+        for ( const Identifier& I : identifiers )
+            Index->insert( I.hash, this );
+        identifierIndex = Index;
+    }
+
+    void unindexIdentifiers()
+    {
+        const QSharedPointer< QSourceIdentifierIndex > Index = identifierIndex.toStrongRef();
+        if ( Index != nullptr )
+        {
+            for ( const Identifier& I : identifiers )
+                Index->remove( I.hash, this );
+        }
+        identifierIndex.clear();
+    }
+
+    void addFold( bool Open )
+    {
+        foldDelta += Open ? 1 : -1;
+        foldMin = qMin( foldMin, foldDelta );
+    }
+
+    /**
+     * @brief true if a fold region starts in this block
+     * @details e.g. "} else {" closes one region and opens another
+     */
+    bool opensFold() const
+    {
+        return foldDelta > foldMin;
+    }
+
+    /**
+     * @brief index of the bracket at Pos in brackets or -1
+     */
+    int bracketAt( int Pos ) const
+    {
+        auto It = std::lower_bound( brackets.cbegin(), brackets.cend(), Pos,
+                                    []( const Bracket& B, int P ) { return B.position < P; } );
+        return ( It != brackets.cend() && It->position == Pos ) ? int( It - brackets.cbegin() ) : -1;
+    }
+
+    // brackets in code context (not in strings or comments), sorted by position
+    QVector< Bracket > brackets;
+    // running depth at the end of the block, relative to its start
+    int depthDelta[ BracketKindCount ] = { 0, 0, 0 };
+    // lowest running depth reached inside the block, relative to its start
+    int minDepth[ BracketKindCount ] = { 0, 0, 0 };
+
+    // outline symbols, see QSourceHighlighter::symbols()
+    QVector< Symbol > symbols;
+
+    // identifiers in code context, recorded while an index is kept, and
+    // the index listing the block under them together with the block itself
+    QVector< Identifier >                  identifiers;
+    QWeakPointer< QSourceIdentifierIndex > identifierIndex;
+    QTextBlock                             block;
+
+    // block state the block was entered with
+    int startState = -1;
+    // fold markers, summarized like the bracket depths
+    int foldDelta = 0;
+    int foldMin   = 0;
+    // indentation width for indentation folded languages, -1 for blank lines
+    int indent = -1;
+
+    // lexing was deferred by QSourceHighlightScheduler, the formats and
+    // the state are still those of a previous lexing
+    bool pending = false;
+
+    // semantic tokens, kept when the block is lexed again but dropped
+    // once its text changes, which overlayHash tells
+    OverlayTree overlays;
+    uint        overlayHash = 0;
+
+    // kept for long lines, lexed in segments, and for blocks with overlays
+    QVector< Checkpoint > checkpoints;
+    QVector< Format >     formats;
+    QVector< Context >    contexts;
+};
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "qsourcecodeviewer.h"
+
+#include <QFontDatabase>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtConcurrent>
+#include <climits>
+#include <cstring>
+
+// checkpoints whose state is computed at most to reach a line, beyond that
+// the checkpoint of the line is assumed to start in code
+static const int MaxCatchUp = 64;
+
+// the width of a column in the fixed font
+static int charWidth( const QFontMetrics& FM )
+{
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 11, 0 )
+    return FM.horizontalAdvance( QChar( 'M' ) );
+#else
+    return FM.width( QChar( 'M' ) );
+#endif
+}
+
+QSourceCodeViewer::QSourceCodeViewer( QWidget* parent )
+    : QAbstractScrollArea( parent )
+    , _lexer( new QSourceHighlighter( nullptr ) )
+    , _data( nullptr )
+    , _size( 0 )
+    , _cancelIndexing( false )
+    , _generation( 0 )
+    , _statesValid( 0 )
+    , _lineCount( 0 )
+    , _cachedLine( -1 )
+    , _cachedState( -1 )
+    , _maxColumns( 0 )
+    , _tabWidth( 4 )
+{
+    _lexer->setParent( this );
+    _theme = _lexer->getTheme( QString() );
+
+    setFont( QFontDatabase::systemFont( QFontDatabase::FixedFont ) );
+    viewport()->setCursor( Qt::IBeamCursor );
+}
+
+QSourceCodeViewer::~QSourceCodeViewer()
+{
+    closeFile();
+}
+
+bool QSourceCodeViewer::openFile( const QString& fileName )
+{
+    closeFile();
+
+    _file.setFileName( fileName );
+    if ( !_file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    _size = _file.size();
+    if ( _size > 0 )
+    {
+        _data = reinterpret_cast< const char* >( _file.map( 0, _size ) );
+        if ( _data == nullptr )
+        {
+            _file.close();
+            _size = 0;
+            return false;
+        }
+    }
+
+    const QString language = QSourceHighlighter::languageForFile( fileName );
+    if ( !language.isEmpty() )
+        _lexer->setCurrentLanguage( language );
+
+    _checkpoints.append( 0 );
+    _states.append( _lexer->initialState() );
+    _statesValid = 1;
+    _lineCount   = 1;
+
+    // the scan runs without locks, it hands over the checkpoints it found
+    // in batches, small ones first so the beginning shows up right away
+    const char* Data       = _data;
+    const qint64 Size      = _size;
+    const int   Generation = ++_generation;
+    _cancelIndexing        = false;
+    _indexing = QtConcurrent::run( [ this, Data, Size, Generation ]() {
+        QVector< qint64 > Batch;
+        int               BatchLimit = 16;
+        int               Lines      = 1;
+        qint64            Pos        = 0;
+
+        auto post = [ & ]( bool Finished ) {
+            QMetaObject::invokeMethod(
+                this,
+                [ this, Batch, Lines, Finished, Generation ]() {
+                    // a batch of a file closed meanwhile
+                    if ( Generation == _generation )
+                        addCheckpoints( Batch, Lines, Finished );
+                },
+                Qt::QueuedConnection );
+        };
+
+        while ( Pos < Size && Lines < INT_MAX && !_cancelIndexing )
+        {
+            const void* NL = std::memchr( Data + Pos, '\n', size_t( Size - Pos ) );
+            if ( NL == nullptr )
+                break;
+            Pos = static_cast< const char* >( NL ) - Data + 1;
+            if ( Lines % CheckpointLines == 0 )
+            {
+                Batch.append( Pos );
+                if ( Batch.size() >= BatchLimit )
+                {
+                    post( false );
+                    Batch.clear();
+                    BatchLimit = qMin( BatchLimit * 2, 65536 );
+                }
+            }
+            ++Lines;
+        }
+        if ( !_cancelIndexing )
+            post( true );
+    } );
+
+    updateScrollBars();
+    viewport()->update();
+    return true;
+}
+
+void QSourceCodeViewer::closeFile()
+{
+    _cancelIndexing = true;
+    _indexing.waitForFinished();
+    ++_generation;
+
+    if ( _data != nullptr )
+        _file.unmap( reinterpret_cast< uchar* >( const_cast< char* >( _data ) ) );
+    _file.close();
+    _data = nullptr;
+    _size = 0;
+
+    _checkpoints.clear();
+    _states.clear();
+    _statesValid = 0;
+    _lineCount   = 0;
+    _cachedLine  = -1;
+    _maxColumns  = 0;
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+void QSourceCodeViewer::addCheckpoints( const QVector< qint64 >& offsets, int lines, bool finished )
+{
+    const int OldLineCount = _lineCount;
+    _checkpoints += offsets;
+    _states.resize( _checkpoints.size() );
+    _lineCount = lines;
+
+    updateScrollBars();
+    // repaint only if the new lines are on screen
+    if ( verticalScrollBar()->value() + viewport()->height() / fontMetrics().height() >= OldLineCount - 1 )
+        viewport()->update();
+    if ( finished )
+        emit indexingFinished( _lineCount );
+}
+
+bool QSourceCodeViewer::setCurrentLanguage( const QString& language )
+{
+    const bool Found = _lexer->setCurrentLanguage( language );
+    resetStates();
+    return Found;
+}
+
+void QSourceCodeViewer::applyTheme( const QString& themeName )
+{
+    _lexer->applyTheme( themeName );
+    _theme = _lexer->getTheme( themeName );
+    viewport()->update();
+}
+
+void QSourceCodeViewer::resetStates()
+{
+    _states.fill( -1 );
+    if ( !_states.isEmpty() )
+        _states[ 0 ] = _lexer->initialState();
+    _statesValid = qMin( 1, _states.size() );
+    _cachedLine  = -1;
+    viewport()->update();
+}
+
+int QSourceCodeViewer::lineCount() const
+{
+    return _lineCount;
+}
+
+bool QSourceCodeViewer::isIndexing() const
+{
+    return _indexing.isRunning();
+}
+
+QString QSourceCodeViewer::line( int lineNumber ) const
+{
+    if ( lineNumber < 0 || lineNumber >= _lineCount || _data == nullptr )
+        return QString();
+
+    qint64 Start = lineStart( lineNumber );
+    return ( Start < 0 ) ? QString() : nextLine( Start );
+}
+
+/**
+ * @brief byte offset of lineNumber, walking from its checkpoint, -1 past the data
+ */
+qint64 QSourceCodeViewer::lineStart( int lineNumber ) const
+{
+    qint64 Start = _checkpoints[ lineNumber / CheckpointLines ];
+    for ( int L = lineNumber % CheckpointLines; L > 0; --L )
+    {
+        const void* NL = std::memchr( _data + Start, '\n', size_t( _size - Start ) );
+        if ( NL == nullptr )
+            return -1;
+        Start = static_cast< const char* >( NL ) - _data + 1;
+    }
+    return Start;
+}
+
+/**
+ * @brief the line at byte offset start, which moves on to the next line,
+ * so consecutive lines are read without walking from a checkpoint each time
+ */
+QString QSourceCodeViewer::nextLine( qint64& start ) const
+{
+    if ( start >= _size )
+        return QString();
+
+    const void*  NL    = std::memchr( _data + start, '\n', size_t( _size - start ) );
+    qint64       End   = ( NL != nullptr ) ? static_cast< const char* >( NL ) - _data : _size;
+    const qint64 Begin = start;
+    start              = End + 1;
+    if ( End > Begin && _data[ End - 1 ] == '\r' )
+        --End;
+
+    // a UTF-8 char takes at most 4 bytes
+    const qint64 Bytes = qMin< qint64 >( End - Begin, qint64( MaxLineLength ) * 4 );
+    QString      Text  = QString::fromUtf8( _data + Begin, int( Bytes ) );
+    if ( Text.length() > MaxLineLength )
+        Text.truncate( MaxLineLength );
+    return Text;
+}
+
+void QSourceCodeViewer::scrollToLine( int lineNumber )
+{
+    verticalScrollBar()->setValue( lineNumber );
+}
+
+/**
+ * @brief lex the lines from up to to starting in state, reading them one
+ * after the other
+ * @returns the state after them
+ */
+int QSourceCodeViewer::lexLines( int from, int to, int state )
+{
+    if ( from >= to )
+        return state;
+
+    QVector< QSourceHighlighter::Span > Scratch;
+    qint64                              Start = lineStart( from );
+    for ( int L = from; L < to && Start >= 0; ++L )
+    {
+        Scratch.clear();
+        state = _lexer->highlightLine( nextLine( Start ), state, Scratch );
+    }
+    return state;
+}
+
+/**
+ * @brief The lexer state lineNumber starts in
+ * @details Continues from the last line lexed if it is close, otherwise
+ * from the nearest checkpoint. Checkpoint states are extended at most
+ * MaxCatchUp checkpoints at a time.
+ */
+int QSourceCodeViewer::stateAt( int lineNumber )
+{
+    const int K = lineNumber / CheckpointLines;
+
+    while ( _statesValid <= K && _statesValid < _states.size() && K - _statesValid < MaxCatchUp )
+    {
+        _states[ _statesValid ] = lexLines( ( _statesValid - 1 ) * CheckpointLines, _statesValid * CheckpointLines, _states[ _statesValid - 1 ] );
+        ++_statesValid;
+    }
+
+    int From  = K * CheckpointLines;
+    int State = ( K < _statesValid ) ? _states[ K ] : _lexer->initialState();
+    if ( _cachedLine > From && _cachedLine <= lineNumber )
+    {
+        From  = _cachedLine;
+        State = _cachedState;
+    }
+    State = lexLines( From, lineNumber, State );
+
+    _cachedLine  = lineNumber;
+    _cachedState = State;
+    return State;
+}
+
+void QSourceCodeViewer::updateScrollBars()
+{
+    const int LineHeight = fontMetrics().height();
+    const int Visible    = qMax( 1, viewport()->height() / LineHeight );
+    verticalScrollBar()->setRange( 0, qMax( 0, _lineCount - Visible ) );
+    verticalScrollBar()->setPageStep( Visible );
+    verticalScrollBar()->setSingleStep( 1 );
+
+    const int CharWidth = charWidth( fontMetrics() );
+    horizontalScrollBar()->setRange( 0, qMax( 0, _maxColumns * CharWidth - viewport()->width() ) );
+    horizontalScrollBar()->setPageStep( viewport()->width() );
+    horizontalScrollBar()->setSingleStep( CharWidth );
+}
+
+void QSourceCodeViewer::resizeEvent( QResizeEvent* event )
+{
+    QAbstractScrollArea::resizeEvent( event );
+    updateScrollBars();
+}
+
+void QSourceCodeViewer::scrollContentsBy( int, int )
+{
+    viewport()->update();
+}
+
+void QSourceCodeViewer::paintEvent( QPaintEvent* )
+{
+    QPainter P( viewport() );
+    P.fillRect( viewport()->rect(), palette().base() );
+    if ( _lineCount == 0 )
+        return;
+
+    const QFontMetrics FM         = fontMetrics();
+    const int          LineHeight = FM.height();
+    const int          CharWidth  = charWidth( FM );
+    const int          X0         = 4 - horizontalScrollBar()->value();
+    const int          First      = verticalScrollBar()->value();
+    const int          Last       = qMin( _lineCount - 1, First + viewport()->height() / LineHeight );
+
+    QVector< QSourceHighlighter::Span > Spans;
+    QVector< int >                      Owner;   // span formatting each char, the last one wins
+    QVector< int >                      Columns; // display column of each char, tabs expanded
+    const int                           OldMaxColumns = _maxColumns;
+
+    int    State = stateAt( First );
+    qint64 Start = lineStart( First );
+    for ( int L = First; L <= Last; ++L )
+    {
+        const QString Text = ( Start >= 0 ) ? nextLine( Start ) : QString();
+        Spans.clear();
+        const int Next = _lexer->highlightLine( Text, State, Spans );
+
+        Owner.fill( -1, Text.length() );
+        for ( int S = 0; S < Spans.size(); ++S )
+        {
+            const int End = qMin( Text.length(), Spans[ S ].start + Spans[ S ].length );
+            for ( int C = qMax( 0, Spans[ S ].start ); C < End; ++C )
+                Owner[ C ] = S;
+        }
+
+        QString Display;
+        Display.reserve( Text.length() );
+        Columns.resize( Text.length() + 1 );
+        for ( int C = 0; C < Text.length(); ++C )
+        {
+            Columns[ C ] = Display.length();
+            if ( Text.at( C ) == QChar( '\t' ) )
+                Display += QString( _tabWidth - Display.length() % _tabWidth, QChar( ' ' ) );
+            else
+                Display += Text.at( C );
+        }
+        Columns[ Text.length() ] = Display.length();
+        _maxColumns              = qMax( _maxColumns, Display.length() );
+
+        const int Y = ( L - First ) * LineHeight;
+        for ( int Start = 0; Start < Text.length(); )
+        {
+            int End = Start + 1;
+            while ( End < Text.length() && Owner[ End ] == Owner[ Start ] )
+                ++End;
+
+            QTextCharFormat F;
+            if ( Owner[ Start ] != -1 )
+            {
+                const QSourceHighlighter::Span& S = Spans[ Owner[ Start ] ];
+                F                                 = _theme.value( S.token );
+                if ( S.modifiers & QSourceHighlighter::Underline )
+                    F.setFontUnderline( true );
+                if ( S.modifiers & QSourceHighlighter::ColorSwatch )
+                    F.setBackground( QColor::fromRgba( S.color ) );
+            }
+
+            const QRect R( X0 + Columns[ Start ] * CharWidth, Y, ( Columns[ End ] - Columns[ Start ] ) * CharWidth, LineHeight );
+            if ( R.right() >= 0 && R.left() <= viewport()->width() )
+            {
+                if ( F.background().style() != Qt::NoBrush )
+                    P.fillRect( R, F.background() );
+                QFont Font = font();
+                Font.setBold( F.fontWeight() > QFont::Normal );
+                Font.setItalic( F.fontItalic() );
+                Font.setUnderline( F.fontUnderline() );
+                P.setFont( Font );
+                P.setPen( ( F.foreground().style() != Qt::NoBrush ) ? F.foreground().color() : palette().text().color() );
+                P.drawText( R.left(), Y + FM.ascent(), Display.mid( Columns[ Start ], Columns[ End ] - Columns[ Start ] ) );
+            }
+            Start = End;
+        }
+        State = Next;
+    }
+
+    // continue from the last painted line when scrolling down
+    _cachedLine  = Last + 1;
+    _cachedState = State;
+
+    if ( _maxColumns != OldMaxColumns )
+        updateScrollBars();
+}
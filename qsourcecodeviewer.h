@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "qsourcehighlighter.h"
+
+#include <QAbstractScrollArea>
+#include <QFile>
+#include <QFuture>
+#include <QVector>
+
+#include <atomic>
+
+/**
+ * @brief Read-only viewer for huge files, without a QTextDocument
+ * @details The file is memory mapped and only every CheckpointLines-th
+ * line position is kept, found by a background scan, so the memory used
+ * barely depends on the file size. Only the visible lines are decoded and
+ * lexed, with highlightLine(), starting from the lexer state saved at the
+ * nearest checkpoint. Checkpoint states are computed on demand, a jump
+ * far beyond the last known state assumes the checkpoint starts in code.
+ * The text is painted directly with the current theme and a fixed font.
+ */
+class QSOURCEHIGHLIGHTER_EXPORT QSourceCodeViewer : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    enum
+    {
+        CheckpointLines = 256,
+        // longer lines are cut for display and lexing
+        MaxLineLength = 0x10000
+    };
+
+    explicit QSourceCodeViewer( QWidget* parent = nullptr );
+    ~QSourceCodeViewer() override;
+
+    /**
+     * @brief shows fileName, the language is chosen from its suffix
+     * @returns false if the file can't be mapped
+     * @details Returns right away, the lines are indexed in the background
+     * and lineCount() grows until indexingFinished() is emitted.
+     */
+    bool openFile( const QString& fileName );
+    void closeFile();
+
+    bool setCurrentLanguage( const QString& language );
+    void applyTheme( const QString& themeName );
+
+    Q_REQUIRED_RESULT int  lineCount() const;
+    Q_REQUIRED_RESULT bool isIndexing() const;
+    /**
+     * @brief the text of a line, without the line break
+     */
+    Q_REQUIRED_RESULT QString line( int lineNumber ) const;
+    void                      scrollToLine( int lineNumber );
+
+signals:
+    void indexingFinished( int lineCount );
+
+protected:
+    void paintEvent( QPaintEvent* event ) override;
+    void resizeEvent( QResizeEvent* event ) override;
+    void scrollContentsBy( int dx, int dy ) override;
+
+private:
+    void                  addCheckpoints( const QVector< qint64 >& offsets, int lines, bool finished );
+    void                  updateScrollBars();
+    Q_REQUIRED_RESULT int stateAt( int lineNumber );
+    Q_REQUIRED_RESULT qint64 lineStart( int lineNumber ) const;
+    Q_REQUIRED_RESULT QString nextLine( qint64& start ) const;
+    Q_REQUIRED_RESULT int     lexLines( int from, int to, int state );
+    void                  resetStates();
+
+    QSourceHighlighter*       _lexer;
+    QSourceHighlighter::Theme _theme;
+
+    QFile               _file;
+    const char*         _data;
+    qint64              _size;
+    QFuture< void >     _indexing;
+    std::atomic< bool > _cancelIndexing;
+    int                 _generation; // of the open file, for the batches of the scan
+
+    // position of every CheckpointLines-th line
+    QVector< qint64 > _checkpoints;
+    // lexer state at the checkpoints, exact for the first _statesValid ones
+    QVector< int > _states;
+    int            _statesValid;
+    int            _lineCount;
+    // the state of the last line lexed, so scrolling continues from there
+    int _cachedLine;
+    int _cachedState;
+
+    int _maxColumns;
+    int _tabWidth;
+};
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "qsourcehighlightcache.h"
+#include "languagedata.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <climits>
+
+// the file layout, in host byte order: a cache is never moved between machines
+static const quint32 CacheMagic  = 0x43485351; // "QSHC"
+static const quint32 CacheFormat = 1;
+
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 format;
+    quint32 lineCount;
+    quint32 itemCount;
+    quint32 colorCount;
+};
+
+template< typename T >
+static bool readArray( QIODevice& D, QVector< T >& V )
+{
+    const qint64 Bytes = qint64( V.size() ) * qint64( sizeof( T ) );
+    return Bytes == 0 || D.read( reinterpret_cast< char* >( V.data() ), Bytes ) == Bytes;
+}
+
+template< typename T >
+static void writeArray( QIODevice& D, const QVector< T >& V )
+{
+    D.write( reinterpret_cast< const char* >( V.constData() ), qint64( V.size() ) * qint64( sizeof( T ) ) );
+}
+
+void QSourceHighlightCacheEntry::clear()
+{
+    offsets.clear();
+    lengths.clear();
+    kinds.clear();
+    colors.clear();
+    lineItems = { 0 };
+    lineStates.clear();
+}
+
+void QSourceHighlightCacheEntry::addItem( int offset, int length, quint8 kind, QRgb color )
+{
+    while ( length > 0 )
+    {
+        const int part = qMin( length, 0xFFFF );
+        offsets.append( quint32( offset ) );
+        lengths.append( quint16( part ) );
+        kinds.append( kind );
+        if ( ( kind & ItemTypeMask ) == FormatItem && ( kind & ( QSourceHighlighter::ColorSwatch << 4 ) ) )
+            colors.append( color );
+        offset += part;
+        length -= part;
+    }
+}
+
+void QSourceHighlightCacheEntry::endLine( int state )
+{
+    lineStates.append( quint8( state ) );
+    lineItems.append( offsets.size() );
+}
+
+void QSourceHighlightCacheEntry::write( QIODevice& device ) const
+{
+    const CacheHeader Header{ CacheMagic, CacheFormat, quint32( lineStates.size() ), quint32( offsets.size() ), quint32( colors.size() ) };
+    device.write( reinterpret_cast< const char* >( &Header ), sizeof( Header ) );
+
+    writeArray( device, lineItems );
+    writeArray( device, lineStates );
+    writeArray( device, offsets );
+    writeArray( device, lengths );
+    writeArray( device, kinds );
+    writeArray( device, colors );
+}
+
+bool QSourceHighlightCacheEntry::read( QIODevice& device )
+{
+    clear();
+
+    CacheHeader Header;
+    if ( device.read( reinterpret_cast< char* >( &Header ), sizeof( Header ) ) != qint64( sizeof( Header ) ) || Header.magic != CacheMagic || Header.format != CacheFormat )
+        return false;
+
+    const qint64 Expected = ( qint64( Header.lineCount ) + 1 ) * 4 + Header.lineCount + qint64( Header.itemCount ) * ( 4 + 2 + 1 ) + qint64( Header.colorCount ) * 4;
+    if ( device.bytesAvailable() != Expected || Header.itemCount > quint32( INT_MAX / 4 ) || Header.lineCount > quint32( INT_MAX / 4 ) )
+        return false;
+
+    lineItems.resize( int( Header.lineCount ) + 1 );
+    lineStates.resize( int( Header.lineCount ) );
+    offsets.resize( int( Header.itemCount ) );
+    lengths.resize( int( Header.itemCount ) );
+    kinds.resize( int( Header.itemCount ) );
+    colors.resize( int( Header.colorCount ) );
+
+    bool Valid = readArray( device, lineItems ) && readArray( device, lineStates ) && readArray( device, offsets ) && readArray( device, lengths ) && readArray( device, kinds ) && readArray( device, colors );
+    // the line index is trusted when replaying, check it once here
+    for ( int L = 0; Valid && L < lineStates.size(); ++L )
+        Valid = lineItems[ L ] <= lineItems[ L + 1 ] && lineStates[ L ] < ALanguage::StateCount;
+    if ( !Valid || lineItems.first() != 0 || lineItems.last() != Header.itemCount )
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+QSourceHighlightCache::QSourceHighlightCache( const QString& directory )
+    : _directory( directory )
+    , _maximumSize( 64 * 1024 * 1024 )
+{
+    if ( _directory.isEmpty() )
+        _directory = QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + QStringLiteral( "/qsourcehighlighter" );
+}
+
+QString QSourceHighlightCache::directory() const
+{
+    return _directory;
+}
+
+void QSourceHighlightCache::setMaximumSize( qint64 bytes )
+{
+    _maximumSize = bytes;
+    evict();
+}
+
+qint64 QSourceHighlightCache::maximumSize() const
+{
+    return _maximumSize;
+}
+
+QByteArray QSourceHighlightCache::key( const QString& text, const QString& language, const QByteArray& languageVersion, int engineVersion )
+{
+    QCryptographicHash H( QCryptographicHash::Sha1 );
+    H.addData( reinterpret_cast< const char* >( text.constData() ), text.size() * int( sizeof( QChar ) ) );
+    H.addData( language.toUtf8() );
+    H.addData( languageVersion );
+    H.addData( QByteArray::number( engineVersion ) );
+    return H.result().toHex();
+}
+
+QString QSourceHighlightCache::fileName( const QByteArray& key ) const
+{
+    return _directory + QChar( '/' ) + QString::fromLatin1( key ) + QStringLiteral( ".qshc" );
+}
+
+bool QSourceHighlightCache::load( const QByteArray& key, Entry& entry )
+{
+    entry.clear();
+
+    QFile F( fileName( key ) );
+    if ( !F.open( QIODevice::ReadOnly ) )
+        return false;
+
+    // a broken entry never becomes valid, it is removed right away
+    if ( !entry.read( F ) )
+    {
+        F.close();
+        F.remove();
+        return false;
+    }
+    F.close();
+
+    // the modification time orders the entries for eviction
+    F.open( QIODevice::ReadWrite );
+    F.setFileTime( QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime );
+    return true;
+}
+
+void QSourceHighlightCache::store( const QByteArray& key, const Entry& entry )
+{
+    if ( entry.lineItems.size() != entry.lineStates.size() + 1 )
+        return;
+    if ( !QDir().mkpath( _directory ) )
+        return;
+
+    QSaveFile F( fileName( key ) );
+    if ( !F.open( QIODevice::WriteOnly ) )
+        return;
+
+    entry.write( F );
+    if ( F.commit() )
+        evict();
+}
+
+void QSourceHighlightCache::clear()
+{
+    const QFileInfoList Entries = QDir( _directory ).entryInfoList( { QStringLiteral( "*.qshc" ) }, QDir::Files );
+    for ( const QFileInfo& FI : Entries )
+        QFile::remove( FI.absoluteFilePath() );
+}
+
+/**
+ * @brief remove the least recently used entries until the cache fits
+ */
+void QSourceHighlightCache::evict()
+{
+    // newest first
+    const QFileInfoList Entries = QDir( _directory ).entryInfoList( { QStringLiteral( "*.qshc" ) }, QDir::Files, QDir::Time );
+
+    qint64 Size = 0;
+    for ( const QFileInfo& FI : Entries )
+    {
+        Size += FI.size();
+        if ( Size > _maximumSize )
+            QFile::remove( FI.absoluteFilePath() );
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "qsourcehighlighter.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+/**
+ * @brief the highlighting of a whole document, as struct of arrays
+ * @details Items are sorted by line, a line has the items from
+ * lineItems[line] to lineItems[line + 1]. Items longer than 0xFFFF
+ * chars are split. Colors are consumed in order by the items with
+ * the ColorSwatch modifier.
+ */
+struct QSOURCEHIGHLIGHTER_EXPORT QSourceHighlightCacheEntry
+{
+    enum ItemType {
+        FormatItem = 0x00,  // formatted range, kind has the Token and FormatModifier flags
+        ContextItem = 0x40, // string or comment, kind has the Token
+        SymbolItem = 0x80,  // outline symbol, kind has the SymbolKind
+        ItemTypeMask = 0xC0,
+    };
+
+    QVector< quint32 > offsets; // document positions
+    QVector< quint16 > lengths;
+    QVector< quint8 >  kinds; // ItemType | token or symbol kind | modifiers << 4
+    QVector< QRgb >    colors;
+    QVector< quint32 > lineItems{ 0 }; // first item of each line, plus offsets.size()
+    QVector< quint8 >  lineStates;     // state after each line, relative to the language
+
+    int lineCount() const
+    {
+        return lineStates.size();
+    }
+    void clear();
+    void addItem( int offset, int length, quint8 kind, QRgb color = 0 );
+    void endLine( int state );
+
+    /**
+     * @brief writes the entry in the layout of the cache files, in host byte
+     * order, also used by QSourceHighlightServer
+     */
+    void write( QIODevice& device ) const;
+    /**
+     * @brief reads an entry written by write(), up to the end of device
+     * @returns false if it isn't a valid entry, the entry is cleared then
+     */
+    bool read( QIODevice& device );
+};
+
+/**
+ * @brief On-disk cache of highlighting results, for large files that are
+ * opened again and again
+ * @details Entries are keyed by the file content, the language definition
+ * and the lexer version, so a stale entry is never used, it just ages out.
+ * The least recently used entries are removed beyond maximumSize().
+ * Entries are written atomically, several processes can share a directory.
+ * @see QSourceHighlighter::setCache()
+ */
+class QSOURCEHIGHLIGHTER_EXPORT QSourceHighlightCache
+{
+public:
+    typedef QSourceHighlightCacheEntry Entry;
+
+    /**
+     * @param directory where entries are stored, the user's cache location if empty
+     */
+    explicit QSourceHighlightCache( const QString& directory = QString() );
+
+    Q_REQUIRED_RESULT QString directory() const;
+    /**
+     * @brief the size of the cache directory in bytes, 64 MiB by default
+     */
+    void                     setMaximumSize( qint64 bytes );
+    Q_REQUIRED_RESULT qint64 maximumSize() const;
+
+    /**
+     * @brief the key of a document
+     * @param languageVersion changes whenever the language definition changes
+     * @param engineVersion changes whenever the lexer output changes
+     */
+    Q_REQUIRED_RESULT static QByteArray key( const QString& text, const QString& language, const QByteArray& languageVersion, int engineVersion );
+
+    /**
+     * @returns false if there is no valid entry for key
+     */
+    bool load( const QByteArray& key, Entry& entry );
+    /**
+     * @brief store entry and evict the oldest entries beyond maximumSize()
+     */
+    void store( const QByteArray& key, const Entry& entry );
+    void clear();
+
+private:
+    QString fileName( const QByteArray& key ) const;
+    void    evict();
+
+    QString _directory;
+    qint64  _maximumSize;
+};
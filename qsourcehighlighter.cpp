@@ -23,47 +23,268 @@
 
 #include "qsourcehighlighter.h"
 #include "languagedata.h"
+#include "qsourcehighlightcache.h"
+#include "qsourcehighlightscheduler.h"
+#include "annotationmatcher.h"
 
+#include <QCryptographicHash>
 #include <QDebug>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QLocale>
 #include <QSettings>
+#include <QTextBlock>
+#include <QTextCursor>
 #include <QTextDocument>
+#include <QTextLayout>
+#include <QTimer>
+#include <QtConcurrent>
 #include <algorithm>
+#include <climits>
+#include <iterator>
+#include <limits>
 
 QMap<QString, QSourceHighlighter::Theme> QSourceHighlighter::Themes;
+// part of the highlight cache keys, increment it whenever the lexer output changes
+static const int LexerVersion = 4;
+// checkpoints of long lines also cover this many chars after them, the
+// lexer looks ahead a little when it decides about a token before them
+static const int CheckpointMargin = 16;
 static LanguageDB* AllLanguages = nullptr;
 
-QSourceHighlighter::QSourceHighlighter( QTextDocument* doc )
-    : QSyntaxHighlighter( doc )
-    , _language( nullptr )
+static LanguageDB* allLanguages()
 {
     if ( AllLanguages == nullptr )
     {
-
+#ifndef QSOURCEHIGHLIGHTER_STATIC_LANGUAGES
         Q_INIT_RESOURCE( qsourcehighlighterlanguages );
+#endif
 
         AllLanguages = new LanguageDB();
+    }
+    return AllLanguages;
+}
+
+static bool isWordChar( QChar c )
+{
+    return c.isLetterOrNumber() || c == QChar( '_' );
+}
+
+static bool isLetter( QChar c )
+{
+    return c.isLetter();
+}
+
+// chars ending a name in an xml tag, or an unquoted html attribute value
+static bool endsXmlName( QChar c, bool value )
+{
+    switch ( c.unicode() )
+    {
+        case '>':
+        case '<':
+        case '"':
+        case '\'':
+            return true;
+        case '=':
+        case '/':
+            return !value;
+        default:
+            return c.isSpace();
+    }
+}
+
+// chars ending a link in a comment or string
+static bool endsLink( QChar c )
+{
+    return c.isSpace() || c == QChar( '"' ) || c == QChar( '\'' ) || c == QChar( '<' ) || c == QChar( '>' );
+}
+
+// punctuation after a link, which belongs to the sentence around it
+static bool trailsLink( QChar c )
+{
+    switch ( c.unicode() )
+    {
+        case '.': case ',': case ';': case ':': case '!': case '?': case ')': return true;
+        default: return false;
+    }
+}
+
+// QStringView::indexOf() needs Qt 5.14, the views came with Qt 5.10
+static int indexOf( QStringView text, QChar c, int from = 0 )
+{
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
+    return int( text.indexOf( c, from ) );
+#else
+    for ( int i = qMax( 0, from ); i < text.size(); ++i )
+    {
+        if ( text[ i ] == c )
+            return i;
+    }
+    return -1;
+#endif
+}
+
+static int indexOf( QStringView text, QLatin1String s, int from = 0 )
+{
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
+    return int( text.indexOf( s, from ) );
+#else
+    for ( int i = qMax( 0, from ); i + s.size() <= text.size(); ++i )
+    {
+        if ( text.mid( i ).startsWith( s ) )
+            return i;
+    }
+    return -1;
+#endif
+}
+
+static QSharedPointer< const AnnotationMatcher > annotationMatcher( const QVector< QSourceHighlighter::Annotation >& annotations )
+{
+    QVector< QString > patterns;
+    for ( const QSourceHighlighter::Annotation& A : annotations )
+        patterns.append( A.pattern );
+    return QSharedPointer< const AnnotationMatcher >( new AnnotationMatcher( patterns ) );
+}
+
+static QByteArray annotationKey( const QVector< QSourceHighlighter::Annotation >& annotations )
+{
+    QCryptographicHash H( QCryptographicHash::Sha1 );
+    for ( const QSourceHighlighter::Annotation& A : annotations )
+    {
+        H.addData( A.pattern.toUtf8() );
+        H.addData( QByteArray::number( ( int( A.extent ) << 16 ) | ( int( A.token ) << 8 ) | A.modifiers ) );
+    }
+    return H.result().toHex().left( 16 );
+}
+
+static inline const QSourceBlockData* blockData( const QTextBlock& B )
+{
+    return static_cast< const QSourceBlockData* >( B.userData() );
+}
+
+QSourceHighlighter::QSourceHighlighter( QTextDocument* doc )
+    : QSyntaxHighlighter( doc )
+    , _language( nullptr )
+    , _pendingLanguage( nullptr )
+    , _hooks( nullptr )
+    , _hooksLanguage( nullptr )
+    , _blockData( nullptr )
+    , _blockState( -1 )
+    , _textLength( 0 )
+    , _spanOffset( 0 )
+    , _headless( false )
+    , _spanSink( nullptr )
+    , _segmentLength( 4096 )
+    , _plainLimit( 1 << 20 )
+    , _segmented( false )
+    , _nextCheckpoint( INT_MAX )
+    , _formatEnd( 0 )
+    , _recordFormats( false )
+    , _semanticUpdates( 0 )
+    , _cache( nullptr )
+    , _cacheEntry( nullptr )
+    , _cacheReplay( false )
+    , _cacheLine( 0 )
+    , _cacheColor( 0 )
+    , _foldValid( 0 )
+    , _foldChangedFrom( -1 )
+    , _symbolsChangedFrom( -1 )
+    , _symbolsChangedTo( -1 )
+    , _blockCount( 1 )
+    , _indexSignalPending( false )
+    , _scheduler( nullptr )
+    , _burstBudget( -1 )
+    , _burstLexed( 0 )
+    , _burstDeferred( 0 )
+    , _forcedBlock( -1 )
+    , _pendingFrom( 0 )
+    , _pendingBlocks( 0 )
+    , _editBatching( false )
+    , _backgroundLexing( false )
+    , _backgroundLexer( nullptr )
+    , _backgroundScheduled( false )
+    , _backgroundLine( nullptr )
+    , _backgroundBlock( -1 )
+    , _revision( 0 )
+    , _followMode( false )
+    , _followHasLines( false )
+    , _followPartial( false )
+{
+    if ( AllLanguages == nullptr )
+    {
+        allLanguages();
         // fetch default language
-        _language = AllLanguages->language( "c" );
+        _language = AllLanguages->find( "c" );
+        if ( _language != nullptr )
+            _language->definition->acquire();
     }
 
     {
-        ALanguage* L = AllLanguages->language( "cpp" );
+        ALanguage* L = AllLanguages->find( "cpp" );
         CppID        = ( L ) ? L->id : -1;
     }
     {
-        ALanguage* L = AllLanguages->language( "asm" );
+        ALanguage* L = AllLanguages->find( "asm" );
         AsmID        = ( L ) ? L->id : -1;
     }
     {
-        ALanguage* L = AllLanguages->language( "css" );
+        ALanguage* L = AllLanguages->find( "css" );
         CSSID        = ( L ) ? L->id : -1;
     }
 
+    _batchTimer.setSingleShot( true );
+    connect( &_batchTimer, &QTimer::timeout, this, &QSourceHighlighter::flushEdits );
+
+    if ( doc )
+    {
+        // blocks can disappear without the surviving ones changing their
+        // fold markers, so levels after an edit are always recomputed
+        connect( doc, &QTextDocument::contentsChange, this, [ this ]( int pos, int, int ) {
+            // QTextDocument::revision() stays put without an undo stack, e.g. in follow mode
+            ++_revision;
+            if ( _backgroundJob != nullptr )
+                _backgroundJob->cancel = true;
+            const int blockNumber = document()->findBlock( pos ).blockNumber();
+            invalidateFolds( blockNumber );
+            // symbol positions after an added or removed block have moved
+            if ( document()->blockCount() != _blockCount )
+            {
+                _blockCount = document()->blockCount();
+                markSymbolsChanged( blockNumber, -1 );
+            }
+        } );
+    }
+
+    // the default annotations are compiled once for all highlighters
+    static const QSharedPointer< const AnnotationMatcher > defaultMatcher = annotationMatcher( defaultAnnotations() );
+    static const QByteArray                                defaultKey     = annotationKey( defaultAnnotations() );
+    _annotations       = defaultAnnotations();
+    _annotationMatcher = defaultMatcher;
+    _annotationKey     = defaultKey;
+
     applyTheme("");
 }
 
+QSourceHighlighter::~QSourceHighlighter()
+{
+    if ( _backgroundJob != nullptr )
+    {
+        _backgroundJob->cancel = true;
+        _backgroundFuture.waitForFinished();
+    }
+    delete _backgroundLexer;
+    if ( _scheduler != nullptr )
+    {
+        // nothing left to lex, the document goes away too
+        _pendingBlocks = 0;
+        _scheduler->removeHighlighter( this );
+    }
+    if ( _language != nullptr )
+        _language->definition->release();
+}
+
 QSourceHighlighter::QSourceHighlighter(QTextDocument *doc, const QString &theme)
-    : QSyntaxHighlighter(doc)
+    : QSourceHighlighter(doc)
 {
     applyTheme(theme);
 }
@@ -72,28 +293,244 @@ bool QSourceHighlighter::setCurrentLanguage(const QString &language)
 {
     if ( _language == nullptr || _language->name != language )
     {
-        _language = AllLanguages->language( language );
+        ALanguage* L = AllLanguages->find( language );
+        if ( L == nullptr )
+        {
+            qWarning() << "No syntax file for language" << language;
+        }
+        useLanguage( L );
     }
 
-    return _language != nullptr;
+    return _language != nullptr || _pendingLanguage != nullptr;
 }
 
 bool QSourceHighlighter::setCurrentLanguageByExtension( const QString& ext )
 {
-    ALanguage* L = AllLanguages->languageByExtension( ext );
+    ALanguage* L = AllLanguages->findByExtension( ext );
     if ( L )
     {
         if ( _language == nullptr || _language->name != L->name )
         {
-            _language = L;
+            useLanguage( L );
         }
     }
 
-    return _language != nullptr;
+    return _language != nullptr || _pendingLanguage != nullptr;
+}
+
+/**
+ * @brief Switch to the language L
+ * @details If L is still being loaded by warmUp() the highlighter doesn't
+ * wait for it: the document stays plain until the language is ready and
+ * is rehighlighted then. Otherwise L is loaded right away if needed.
+ */
+void QSourceHighlighter::useLanguage( ALanguage* L )
+{
+    // the definition of _language is in use until it is released here,
+    // a pending one is only acquired once it is loaded
+    if ( _language != nullptr )
+    {
+        _language->definition->release();
+    }
+    _language        = nullptr;
+    _pendingLanguage = nullptr;
+    // a running background job lexes the old language
+    ++_revision;
+
+    // without a document, e.g. for highlightLine(), there is nothing to
+    // rehighlight later so the language is loaded right away
+    if ( document() != nullptr && L != nullptr && !L->definition->loaded && L->definition->loading.isRunning() )
+    {
+        _pendingLanguage = L;
+
+        auto* watcher = new QFutureWatcher< void >( this );
+        connect( watcher, &QFutureWatcher< void >::finished, this, [ this, L, watcher ]() {
+            watcher->deleteLater();
+            // another language may have been chosen meanwhile
+            if ( _pendingLanguage == L )
+            {
+                _pendingLanguage = nullptr;
+                L->definition->acquire();
+                _language = L;
+                invalidateFolds( 0 );
+                requestRehighlight();
+            }
+        } );
+        watcher->setFuture( L->definition->loading );
+        return;
+    }
+
+    if ( L != nullptr )
+    {
+        L->definition->acquire();
+    }
+    _language = L;
+    invalidateFolds( 0 );
+}
+
+QFuture< void > QSourceHighlighter::warmUp( const QStringList& languages )
+{
+    return allLanguages()->preload( languages );
+}
+
+QString QSourceHighlighter::languageForExtension( const QString& extension )
+{
+    const ALanguage* L = allLanguages()->findByExtension( extension );
+    return ( L ) ? L->name : QString();
+}
+
+QString QSourceHighlighter::languageForFile( const QString& fileName )
+{
+    const QFileInfo info( fileName );
+    return languageForExtension( info.suffix().isEmpty() ? info.fileName() : info.suffix() );
+}
+
+int QSourceHighlighter::initialState() const
+{
+    return ( _language ) ? _language->id : -1;
+}
+
+qint64 QSourceHighlighter::languageMemoryUsage( const QString& language )
+{
+    const ALanguage* L = allLanguages()->find( language );
+    return ( L ) ? L->definition->bytesUsed() : 0;
+}
+
+qint64 QSourceHighlighter::languageMemoryUsage()
+{
+    qint64 Bytes = 0;
+    for ( LanguageDefinition* D : qAsConst( allLanguages()->Definitions ) )
+        Bytes += D->bytesUsed();
+    return Bytes;
+}
+
+int QSourceHighlighter::unloadUnusedLanguages( int msecs )
+{
+    return allLanguages()->unloadUnused( msecs );
+}
+
+QStringList QSourceHighlighter::languageDialects( const QString& language )
+{
+    const ALanguage* L = allLanguages()->find( language );
+    if ( L == nullptr )
+        return QStringList();
+    L->definition->ensureLoaded();
+    return L->definition->shardNames();
+}
+
+bool QSourceHighlighter::loadLanguageDialect( const QString& language, const QString& dialect )
+{
+    const ALanguage* L = allLanguages()->find( language );
+    if ( L == nullptr )
+        return false;
+    L->definition->ensureLoaded();
+    return L->definition->loadShard( dialect );
+}
+
+void QSourceHighlighter::addLanguage( const QString& language, const QString& definitionFile, const QStringList& extensions )
+{
+    allLanguages()->addLanguage( language, definitionFile, extensions );
+}
+
+void QSourceHighlighter::setFollowMode( bool enabled, int maxBlocks )
+{
+    _followMode = enabled;
+    _followHasLines = !document()->isEmpty();
+    _followPartial  = false;
+    _followTail.clear();
+
+    // the undo stack would keep every appended chunk
+    document()->setUndoRedoEnabled( !enabled );
+    document()->setMaximumBlockCount( enabled ? maxBlocks : 0 );
+}
+
+bool QSourceHighlighter::followMode() const
+{
+    return _followMode;
+}
+
+/**
+ * @brief Append UTF-8 data to the document in follow mode
+ * @param chunk the data, it may end in the middle of a line or a character
+ * @details Only complete lines are added, in one edit, so QSyntaxHighlighter
+ * lexes just the new blocks starting from the state of the last one. The
+ * incomplete rest waits for the next chunk. Splitting at '\n' is safe for
+ * UTF-8 because it never occurs inside a multibyte sequence. The '\r' of
+ * CRLF lines is dropped, QTextCursor would take a lone one for a line break.
+ */
+void QSourceHighlighter::appendChunk( const QByteArray& chunk )
+{
+    const int lastNewline = chunk.lastIndexOf( '\n' );
+    if ( lastNewline == -1 )
+    {
+        _followTail.append( chunk );
+        return;
+    }
+
+    _followTail.append( chunk.constData(), lastNewline );
+    if ( _followTail.endsWith( '\r' ) )
+        _followTail.chop( 1 );
+    appendLines( QString::fromUtf8( _followTail ) );
+    _followTail    = chunk.mid( lastNewline + 1 );
+    _followPartial = false;
+}
+
+/**
+ * @brief the bytes at the end of data that start a UTF-8 sequence but don't complete it
+ */
+static int incompleteUtf8( const QByteArray& data )
+{
+    const int size = data.size();
+    for ( int n = 1; n <= qMin( 4, size ); ++n )
+    {
+        const uchar c = uchar( data.at( size - n ) );
+        if ( ( c & 0xC0 ) == 0x80 )
+            continue;
+        const int length = ( c >= 0xF0 ) ? 4 : ( c >= 0xE0 ) ? 3 : ( c >= 0xC0 ) ? 2 : 1;
+        return ( length > n ) ? n : 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Append the incomplete last line, e.g. at the end of the file
+ * @details The next chunk continues that line instead of starting another.
+ * A character or CRLF cut by the end of the data waits for that chunk.
+ */
+void QSourceHighlighter::flushFollow()
+{
+    int keep = incompleteUtf8( _followTail );
+    if ( keep == 0 && _followTail.endsWith( '\r' ) )
+        keep = 1;
+    if ( _followTail.size() == keep )
+        return;
+
+    appendLines( QString::fromUtf8( _followTail.constData(), _followTail.size() - keep ) );
+    _followTail    = _followTail.right( keep );
+    _followPartial = true;
+}
+
+void QSourceHighlighter::appendLines( const QString& lines )
+{
+    QTextCursor C( document() );
+    C.movePosition( QTextCursor::End );
+    if ( _followHasLines && !_followPartial )
+    {
+        C.insertText( QStringLiteral( "\n" ) + lines );
+    } else
+    {
+        // the first lines, or the rest of the flushed line
+        C.insertText( lines );
+        _followHasLines = true;
+    }
 }
 
 QString QSourceHighlighter::currentLanguage()
 {
+    if ( _pendingLanguage != nullptr )
+    {
+        return _pendingLanguage->name;
+    }
     return ( _language != nullptr ) ? _language->name : "";
 }
 
@@ -104,31 +541,968 @@ void QSourceHighlighter::highlightBlock( const QString& text )
         // no highlighting set
         return;
     }
+    const bool replay = _backgroundLine != nullptr && currentBlock().blockNumber() == _backgroundBlock;
+    if ( !replay && ( _scheduler != nullptr || _editBatching || _backgroundLexing ) && deferBlock() )
+        return;
 
     if ( currentBlock() == document()->firstBlock() )
     {
-        setCurrentBlockState( _language->id );
+        // in follow mode the first block is usually what remains after
+        // evicting older ones, it keeps the state it was lexed with so the
+        // eviction doesn't cascade through the whole window
+        const auto* D = static_cast< const QSourceBlockData* >( currentBlockUserData() );
+        _blockState   = ( _followMode && D != nullptr && D->startState != -1 ) ? D->startState : _language->id;
     } else
     {
-        setCurrentBlockState( previousBlockState() );
+        _blockState = previousBlockState();
+        // a block deferred by the scheduler or edit batching may still have
+        // the state of another language, this one is lexed again after it
+        if ( _blockState < _language->id || _blockState >= _language->id + ALanguage::StateCount )
+            _blockState = _language->id;
         //        previousBlockState() == _language->id ?
         //            setCurrentBlockState( _language->id ) :
         //            setCurrentBlockState( _language->id + 1 );
     }
 
-    highlightSyntax( text );
+    _blockData = static_cast< QSourceBlockData* >( currentBlockUserData() );
+    if ( _blockData == nullptr )
+    {
+        _blockData = new QSourceBlockData;
+        setCurrentBlockUserData( _blockData );
+    }
+    if ( _blockData->pending )
+    {
+        _blockData->pending = false;
+        _pendingBlocks      = qMax( 0, _pendingBlocks - 1 );
+    }
+    const int  oldFoldDelta = _blockData->foldDelta;
+    const int  oldFoldMin   = _blockData->foldMin;
+    const int  oldIndent    = _blockData->indent;
+    // keep the old symbols for comparison, the swap reuses both buffers
+    _previousSymbols.swap( _blockData->symbols );
+    _previousIdentifiers.swap( _blockData->identifiers );
+    _spanOffset = currentBlock().position();
+    // the lexical formats are kept for applyOverlays()
+    _recordFormats = !_blockData->overlays.isEmpty();
+    // setPlainText() goes through the blocks in order, anything else ends the cache pass
+    if ( _cacheEntry != nullptr && currentBlock().blockNumber() != _cacheLine )
+        _cacheEntry = nullptr;
+
+    if ( replay )
+    {
+        replayBackgroundBlock( text );
+    } else if ( _cacheEntry != nullptr && _cacheReplay )
+    {
+        replayCachedBlock( text );
+    } else if ( _cacheEntry != nullptr )
+    {
+        _cacheSpans.clear();
+        _spanSink = &_cacheSpans;
+        lexBlock( text );
+        _spanSink = nullptr;
+        recordCachedBlock();
+    } else
+    {
+        lexBlock( text );
+    }
+    _recordFormats = false;
+    if ( !_blockData->overlays.isEmpty() )
+        mergeOverlays( text );
+    setCurrentBlockState( _blockState );
+
+    if ( _blockData->foldDelta != oldFoldDelta || _blockData->foldMin != oldFoldMin || _blockData->indent != oldIndent )
+    {
+        invalidateFolds( currentBlock().blockNumber() );
+    }
+    if ( _blockData->symbols != _previousSymbols )
+    {
+        const int blockNumber = currentBlock().blockNumber();
+        markSymbolsChanged( blockNumber, blockNumber );
+    }
+    if ( _identifierIndex != nullptr )
+    {
+        _blockData->block = currentBlock();
+        _blockData->indexIdentifiers( _identifierIndex, _previousIdentifiers );
+    }
+}
+
+/**
+ * @brief rehighlight(), or with a scheduler mark all blocks for its slices
+ */
+void QSourceHighlighter::requestRehighlight()
+{
+    if ( _scheduler == nullptr || document() == nullptr )
+    {
+        rehighlight();
+        return;
+    }
+
+    for ( QTextBlock B = document()->firstBlock(); B.isValid(); B = B.next() )
+    {
+        auto* D = static_cast< QSourceBlockData* >( B.userData() );
+        if ( D == nullptr )
+        {
+            D = new QSourceBlockData;
+            B.setUserData( D );
+        }
+        if ( !D->pending )
+        {
+            D->pending = true;
+            ++_pendingBlocks;
+        }
+    }
+    _pendingFrom = 0;
+    _scheduler->wake();
+}
+
+/**
+ * @brief true if the current block is left to the scheduler
+ * @details Each edit or rehighlight may lex for the time the scheduler
+ * gives it, the blocks after that keep their formats and state, so
+ * QSyntaxHighlighter doesn't continue into the next block because of them.
+ * With edit batching all the blocks of an edit are left for flushEdits().
+ */
+bool QSourceHighlighter::deferBlock()
+{
+    // setPlainText() with a cache and follow mode need their blocks in order
+    if ( _cacheEntry != nullptr || _followMode )
+        return false;
+
+    const int number = currentBlock().blockNumber();
+    bool      defer;
+    bool      batched = false;
+    if ( _forcedBlock != -1 )
+    {
+        // a slice or a flush, the blocks after the first one as long as the budget lasts
+        defer = number != _forcedBlock && _burstTimer.nsecsElapsed() >= _burstBudget;
+    } else if ( _backgroundLexing )
+    {
+        defer = true;
+        scheduleBackgroundJob();
+    } else if ( _editBatching )
+    {
+        defer   = true;
+        batched = true;
+        ++_batchStatistics.requests;
+        _batchTimer.start();
+    } else
+    {
+        if ( _burstBudget < 0 )
+        {
+            // the burst ends when the event loop runs again
+            _burstBudget = _scheduler->immediateBudget( this );
+            _burstTimer.start();
+            QTimer::singleShot( 0, this, [ this ]() { endBurst(); } );
+        }
+        defer = _burstTimer.nsecsElapsed() >= _burstBudget;
+    }
+    if ( !defer )
+    {
+        ++_burstLexed;
+        return false;
+    }
+
+    auto* D = static_cast< QSourceBlockData* >( currentBlockUserData() );
+    if ( D == nullptr )
+    {
+        D = new QSourceBlockData;
+        setCurrentBlockUserData( D );
+    }
+    if ( !D->pending )
+    {
+        D->pending = true;
+        ++_pendingBlocks;
+        if ( batched )
+            ++_batchStatistics.distinct;
+    }
+    _pendingFrom = qMin( _pendingFrom, number );
+    if ( _forcedBlock != -1 || ( !_editBatching && !_backgroundLexing ) )
+        ++_burstDeferred;
+
+    // QSyntaxHighlighter replaces the formats of the block with those set here
+    const QVector< QTextLayout::FormatRange > previous = currentBlock().layout()->formats();
+    for ( const QTextLayout::FormatRange& R : previous )
+        setFormat( R.start, R.length, R.format );
+    if ( _scheduler != nullptr && !_editBatching && !_backgroundLexing )
+        _scheduler->wake();
+    return true;
+}
+
+/**
+ * @brief account an edit or rehighlight burst to the scheduler
+ */
+void QSourceHighlighter::endBurst()
+{
+    if ( _burstBudget < 0 )
+        return;
+    if ( _scheduler != nullptr )
+        _scheduler->account( this, _burstLexed, _burstDeferred, 0 );
+    _burstBudget   = -1;
+    _burstLexed    = 0;
+    _burstDeferred = 0;
+}
+
+/**
+ * @brief lex pending blocks for about budget nsecs, those from firstVisible
+ * to lastVisible first and then the others in order
+ * @returns the number of blocks lexed
+ */
+int QSourceHighlighter::lexPending( qint64 budget, int firstVisible, int lastVisible )
+{
+    endBurst();
+    if ( document() == nullptr || _language == nullptr )
+        return 0;
+
+    _burstBudget = budget;
+    _burstTimer.start();
+
+    for ( int pass = ( firstVisible >= 0 ) ? 0 : 1; pass < 2; ++pass )
+    {
+        const int  last     = ( pass == 0 ) ? lastVisible : INT_MAX;
+        const bool fromStart = pass == 1 && _pendingFrom == 0;
+        QTextBlock B         = document()->findBlockByNumber( ( pass == 0 ) ? firstVisible : _pendingFrom );
+        // a block is always lexed, also if the budget is spent by the one before
+        while ( B.isValid() && B.blockNumber() <= last && _burstTimer.nsecsElapsed() < budget )
+        {
+            const auto* D = blockData( B );
+            if ( D != nullptr && D->pending )
+            {
+                _forcedBlock = B.blockNumber();
+                rehighlightBlock( B );
+                _forcedBlock = -1;
+            }
+            B = B.next();
+        }
+        if ( pass == 1 )
+        {
+            if ( B.isValid() )
+                _pendingFrom = B.blockNumber();
+            else if ( fromStart )
+                _pendingBlocks = 0; // the count is off when pending blocks were removed
+            else
+                _pendingFrom = 0;
+        }
+    }
+
+    const int lexed = _burstLexed;
+    if ( _scheduler != nullptr )
+        _scheduler->account( this, 0, _burstDeferred, lexed );
+    _burstBudget   = -1;
+    _burstLexed    = 0;
+    _burstDeferred = 0;
+    return lexed;
+}
+
+void QSourceHighlighter::setEditBatching( bool enabled, int settleMsecs )
+{
+    _batchTimer.setInterval( qMax( 0, settleMsecs ) );
+    if ( _editBatching == enabled )
+        return;
+    _editBatching = enabled;
+    if ( !enabled )
+        flushEdits();
+}
+
+bool QSourceHighlighter::editBatching() const
+{
+    return _editBatching;
+}
+
+/**
+ * @brief lex the blocks collected by edit batching, each of them once
+ * @details The blocks are lexed in order, so every one starts in the final
+ * state of the one before, also with a scheduler.
+ */
+void QSourceHighlighter::flushEdits()
+{
+    _batchTimer.stop();
+    if ( _pendingBlocks == 0 )
+        return;
+    _batchStatistics.lexed += lexPending( std::numeric_limits< qint64 >::max(), -1, -1 );
+    ++_batchStatistics.flushes;
+}
+
+QSourceHighlighter::BatchStatistics QSourceHighlighter::batchStatistics() const
+{
+    BatchStatistics S = _batchStatistics;
+    // the flush also lexes the blocks after them whose state changed, that isn't avoided lexing
+    S.avoided = S.requests - S.distinct;
+    return S;
+}
+
+void QSourceHighlighter::setBackgroundLexing( bool enabled )
+{
+    if ( _backgroundLexing == enabled )
+        return;
+    _backgroundLexing = enabled;
+    if ( enabled )
+    {
+        if ( _backgroundLexer == nullptr )
+            _backgroundLexer = new QSourceHighlighter( nullptr );
+        return;
+    }
+
+    if ( _backgroundJob != nullptr )
+    {
+        _backgroundJob->cancel = true;
+        _backgroundFuture.waitForFinished();
+    }
+    if ( _pendingBlocks > 0 )
+        lexPending( std::numeric_limits< qint64 >::max(), -1, -1 );
+}
+
+bool QSourceHighlighter::backgroundLexing() const
+{
+    return _backgroundLexing;
+}
+
+/**
+ * @brief the state block is lexed from, as in highlightBlock()
+ */
+int QSourceHighlighter::blockStartState( const QTextBlock& block ) const
+{
+    const QTextBlock previous = block.previous();
+    const int        state    = previous.isValid() ? previous.userState() : -1;
+    return ( state < _language->id || state >= _language->id + ALanguage::StateCount ) ? _language->id : state;
+}
+
+/**
+ * @brief start a background job once the edit is done
+ */
+void QSourceHighlighter::scheduleBackgroundJob()
+{
+    if ( _backgroundScheduled )
+        return;
+    _backgroundScheduled = true;
+    QTimer::singleShot( 0, this, [ this ]() {
+        _backgroundScheduled = false;
+        startBackgroundJob();
+    } );
+}
+
+/**
+ * @brief copy the first run of pending blocks, and the blocks after it,
+ * and lex them on a worker
+ */
+void QSourceHighlighter::startBackgroundJob()
+{
+    // blocks a long way after the edited ones are rarely needed, a state
+    // change reaching that far is continued by the next job
+    enum
+    {
+        MaxLines  = 2000,
+        Lookahead = 200
+    };
+
+    if ( !_backgroundLexing || _backgroundJob != nullptr || _pendingBlocks == 0 || _language == nullptr || document() == nullptr )
+        return;
+
+    QTextBlock B = document()->findBlockByNumber( _pendingFrom );
+    while ( B.isValid() && ( blockData( B ) == nullptr || !blockData( B )->pending ) )
+        B = B.next();
+    if ( !B.isValid() )
+    {
+        if ( _pendingFrom == 0 )
+            _pendingBlocks = 0; // the count is off when pending blocks were removed
+        _pendingFrom = 0;
+        scheduleBackgroundJob();
+        return;
+    }
+    _pendingFrom = B.blockNumber();
+
+    QSharedPointer< BackgroundJob > job( new BackgroundJob );
+    job->revision   = _revision;
+    job->language   = _language;
+    job->firstBlock = B.blockNumber();
+    job->start      = blockStartState( B );
+    for ( int after = 0; B.isValid() && job->texts.size() < MaxLines; B = B.next() )
+    {
+        const bool pending = blockData( B ) != nullptr && blockData( B )->pending;
+        after              = pending ? 0 : after + 1;
+        if ( after > Lookahead )
+            break;
+        job->texts.append( B.text() );
+        job->pending.append( pending );
+        job->oldStates.append( B.userState() );
+    }
+
+    // the worker's highlighter is only touched here while no job runs
+    QSourceHighlighter* lexer = _backgroundLexer;
+    if ( lexer->_language != _language )
+        lexer->useLanguage( _language );
+    lexer->_segmentLength     = _segmentLength;
+    lexer->_plainLimit        = _plainLimit;
+    lexer->_annotations       = _annotations;
+    lexer->_annotationMatcher = _annotationMatcher;
+    lexer->_annotationKey     = _annotationKey;
+
+    _backgroundJob = job;
+    auto* watcher  = new QFutureWatcher< void >( this );
+    connect( watcher, &QFutureWatcher< void >::finished, this, [ this, watcher ]() {
+        watcher->deleteLater();
+        applyBackgroundJob();
+    } );
+    _backgroundFuture = QtConcurrent::run( [ lexer, job ]() { lexer->lexBackgroundJob( *job ); } );
+    watcher->setFuture( _backgroundFuture );
+}
+
+/**
+ * @brief lex the lines of job, on the worker
+ */
+void QSourceHighlighter::lexBackgroundJob( BackgroundJob& job )
+{
+    int state = job.start;
+    for ( int k = 0; k < job.texts.size() && !job.cancel; ++k )
+    {
+        // from here on the blocks are what they were lexed to before
+        if ( k > 0 && !job.pending.at( k ) && state == job.oldStates.at( k - 1 ) )
+            break;
+
+        BackgroundLine line;
+        line.start    = state;
+        state         = highlightLine( job.texts.at( k ), state, line.spans );
+        line.state    = state;
+        line.contexts = _contextSpans;
+        line.symbols  = _lineData.symbols;
+        job.lines.append( line );
+    }
+}
+
+/**
+ * @brief set the results of the finished job on the blocks, on the GUI thread
+ * @details The blocks are highlighted again one by one with their lines
+ * replayed, so QSyntaxHighlighter sets the formats and the block states. A
+ * changed state marks the next block, which the following job lexes.
+ */
+void QSourceHighlighter::applyBackgroundJob()
+{
+    const QSharedPointer< BackgroundJob > job = _backgroundJob;
+    _backgroundJob.reset();
+    if ( job == nullptr || document() == nullptr )
+        return;
+
+    if ( job->revision == _revision && job->language == _language && _backgroundLexing )
+    {
+        QTextBlock B = document()->findBlockByNumber( job->firstBlock );
+        for ( const BackgroundLine& line : qAsConst( job->lines ) )
+        {
+            // lexed by other means meanwhile, the rest is lexed again
+            if ( !B.isValid() || blockStartState( B ) != line.start )
+                break;
+            _backgroundLine  = &line;
+            _backgroundBlock = B.blockNumber();
+            rehighlightBlock( B );
+            B = B.next();
+        }
+        _backgroundLine  = nullptr;
+        _backgroundBlock = -1;
+    }
+    // stale or not, what is still pending is copied again
+    if ( _pendingBlocks > 0 )
+        scheduleBackgroundJob();
+}
+
+/**
+ * @brief Restore the current block from the line the worker lexed
+ */
+void QSourceHighlighter::replayBackgroundBlock( const QString& text )
+{
+    const BackgroundLine& line = *_backgroundLine;
+
+    _blockData->clear();
+    _blockData->startState = _blockState;
+    _textLength            = text.length();
+    for ( const Span& S : line.spans )
+        formatToken( S.start, S.length, S.token, S.modifiers, S.color );
+    _contextSpans       = line.contexts;
+    _blockData->symbols = line.symbols;
+    _blockState         = line.state;
+
+    indexBrackets( text );
+    indexFolds( text );
+}
+
+/**
+ * @brief Lex text into the current _blockData, starting in _blockState
+ */
+void QSourceHighlighter::lexBlock( const QString& text )
+{
+    // the checkpoints of a long line are reused after an edit
+    const int previousStartState = _blockData->startState;
+    _previousCheckpoints.swap( _blockData->checkpoints );
+    _previousFormats.swap( _blockData->formats );
+    _previousContexts.swap( _blockData->contexts );
+
+    _blockData->clear();
+    _blockData->startState = _blockState;
+    _contextSpans.clear();
+    _textLength = text.length();
+
+    if ( _plainLimit > 0 && _textLength > _plainLimit && _language->name == QLatin1String( "xml" ) )
+        xmlHighlighter( text, true );
+    else if ( _plainLimit > 0 && _textLength > _plainLimit )
+        highlightPlain( text );
+    else if ( _segmentLength > 0 && _textLength > _segmentLength && _language->name != QLatin1String( "xml" ) )
+        highlightSegmented( text, previousStartState );
+    else
+    {
+        highlightSyntax( text );
+        annotate( text );
+    }
+    indexBrackets( text );
+    indexFolds( text );
+}
+
+void QSourceHighlighter::setLongLineLimits( int segmentLength, int plainLimit )
+{
+    _segmentLength = qMax( 0, segmentLength );
+    _plainLimit    = qMax( 0, plainLimit );
+    requestRehighlight();
+}
+
+int QSourceHighlighter::longLineSegmentLength() const
+{
+    return _segmentLength;
+}
+
+int QSourceHighlighter::longLinePlainLimit() const
+{
+    return _plainLimit;
+}
+
+/**
+ * @brief Lex a long line, starting from the last checkpoint before the
+ * first change if the line was lexed before
+ * @details A checkpoint is usable if the block starts in the same state and
+ * the text up to the checkpoint, plus a margin, hashes the same. The formats
+ * and contexts before it are then restored instead of lexed.
+ */
+void QSourceHighlighter::highlightSegmented( const QString& text, int previousStartState )
+{
+    int resume = -1;
+    // highlightLine() shares _lineData between unrelated lines
+    if ( !_headless && previousStartState == _blockState )
+    {
+        const QStringView view( text );
+        int               hashFrom = 0;
+        for ( int c = 0; c < _previousCheckpoints.size(); ++c )
+        {
+            const int hashTo = _previousCheckpoints[ c ].position + CheckpointMargin;
+            if ( hashTo > text.length() || uint( qHash( view.mid( hashFrom, hashTo - hashFrom ) ) ) != _previousCheckpoints[ c ].hash )
+                break;
+            resume   = c;
+            hashFrom = hashTo;
+        }
+    }
+
+    _segmented      = true;
+    _nextCheckpoint = _segmentLength;
+    _formatEnd      = 0;
+    highlightSyntax( text, resume );
+    _segmented      = false;
+    _nextCheckpoint = INT_MAX;
+    compactFormats();
+
+    _blockData->contexts.reserve( _contextSpans.size() );
+    for ( const ContextSpan& C : qAsConst( _contextSpans ) )
+        _blockData->contexts.append( QSourceBlockData::Context{ C.start, C.end, int( C.token ) } );
+}
+
+/**
+ * @brief Restore the formats, contexts and state of a long line up to the
+ * checkpoint index of its previous lexing
+ * @details The formats are the runs left by compactFormats(), one per
+ * stretch of chars with the same format, so only what ends up in the
+ * layout is set again.
+ */
+void QSourceHighlighter::restoreCheckpoint( int index )
+{
+    const QSourceBlockData::Checkpoint& C = _previousCheckpoints[ index ];
+
+    for ( int f = 0; f < C.firstFormat; ++f )
+    {
+        const QSourceBlockData::Format& F = _previousFormats[ f ];
+        // a run may go on into the part lexed again
+        const int length = qMin( F.length, C.formatEnd - F.start );
+        if ( F.token == CodeBlock && F.modifiers == NoModifier )
+        {
+            // the block format was applied to the whole line already
+            _blockData->formats.append( QSourceBlockData::Format{ F.start, length, F.token, F.modifiers, F.color } );
+            continue;
+        }
+        formatToken( F.start, length, Token( F.token ), F.modifiers, F.color );
+    }
+    for ( int c = 0; c < C.firstContext; ++c )
+    {
+        const QSourceBlockData::Context& X = _previousContexts[ c ];
+        markContext( X.start, X.end, Token( X.token ) );
+    }
+    for ( int c = 0; c <= index; ++c )
+        _blockData->checkpoints.append( _previousCheckpoints[ c ] );
+
+    _blockState     = C.state;
+    _nextCheckpoint = C.position + _segmentLength;
+    _formatEnd      = C.formatEnd;
+}
+
+/**
+ * @brief Remember that lexing a long line can resume at position
+ */
+void QSourceHighlighter::addCheckpoint( const QString& text, int position )
+{
+    const int hashFrom = _blockData->checkpoints.isEmpty() ? 0 : _blockData->checkpoints.last().position + CheckpointMargin;
+    const int hashTo   = position + CheckpointMargin;
+    if ( hashTo > text.length() )
+    {
+        // too close to the end to be worth it
+        _nextCheckpoint = INT_MAX;
+        return;
+    }
+
+    const uint hash = uint( qHash( QStringView( text ).mid( hashFrom, hashTo - hashFrom ) ) );
+    _blockData->checkpoints.append( QSourceBlockData::Checkpoint{ position, _blockState, hash, int( _blockData->formats.size() ), int( _contextSpans.size() ), qMax( position, _formatEnd ) } );
+    _nextCheckpoint = position + _segmentLength;
+}
+
+/**
+ * @brief Replace the formats recorded for a long line by the runs of chars
+ * with the same final format, and point the checkpoints at them
+ * @details The formats overlap, e.g. the block format covers the whole
+ * line, and a later one wins. The runs are what the layout gets, so
+ * restoreCheckpoint() sets each char once instead of replaying every token.
+ */
+void QSourceHighlighter::compactFormats()
+{
+    const QVector< QSourceBlockData::Format >& formats = _blockData->formats;
+    _formatOwner.fill( -1, _textLength );
+    for ( int f = 0; f < formats.size(); ++f )
+    {
+        const QSourceBlockData::Format& F = formats[ f ];
+        std::fill( _formatOwner.begin() + qMin( F.start, _textLength ), _formatOwner.begin() + qMin( F.start + F.length, _textLength ), f );
+    }
+
+    _compactFormats.clear();
+    for ( int c = 0; c < _textLength; )
+    {
+        const int owner = _formatOwner[ c ];
+        int       end   = c + 1;
+        while ( end < _textLength && _formatOwner[ end ] == owner )
+            ++end;
+        if ( owner != -1 )
+        {
+            const QSourceBlockData::Format& F    = formats[ owner ];
+            QSourceBlockData::Format*       last = _compactFormats.isEmpty() ? nullptr : &_compactFormats.last();
+            if ( last != nullptr && last->start + last->length == c && last->token == F.token && last->modifiers == F.modifiers && last->color == F.color )
+                last->length += end - c;
+            else
+                _compactFormats.append( QSourceBlockData::Format{ c, end - c, F.token, F.modifiers, F.color } );
+        }
+        c = end;
+    }
+    _blockData->formats.swap( _compactFormats );
+
+    // the runs are sorted, a checkpoint restores those starting before it
+    int run = 0;
+    for ( QSourceBlockData::Checkpoint& C : _blockData->checkpoints )
+    {
+        while ( run < _blockData->formats.size() && _blockData->formats[ run ].start < C.position )
+            ++run;
+        C.firstFormat = run;
+    }
+}
+
+/**
+ * @brief Highlight only the strings and comments of a huge line
+ */
+void QSourceHighlighter::highlightPlain( const QString& text )
+{
+    const int   textLen = text.length();
+    const QChar comment = _language->definition->comment;
+    const QChar multi   = _language->definition->multilinestringchar;
+    int         i       = 0;
+
+    formatToken( 0, textLen, CodeBlock );
+
+    if ( _blockState == _language->id + 1 )
+    {
+        i = text.indexOf( QStringLiteral( "*/" ) );
+        if ( i == -1 )
+        {
+            formatToken( 0, textLen, CodeComment );
+            markContext( 0, textLen, CodeComment );
+            return;
+        }
+        i += 2;
+        formatToken( 0, i, CodeComment );
+        markContext( 0, i, CodeComment );
+        _blockState = _language->id;
+    } else if ( _blockState == _language->id + 2 )
+    {
+        i = highlightStringLiterals( multi, text, 0 );
+    }
+
+    for ( ; i < textLen; ++i )
+    {
+        const QChar c = text.at( i );
+        if ( comment.isNull() && c == QChar( '/' ) && i + 1 < textLen && text.at( i + 1 ) == QChar( '/' ) )
+        {
+            formatToken( i, textLen - i, CodeComment );
+            markContext( i, textLen, CodeComment );
+            return;
+        } else if ( comment.isNull() && c == QChar( '/' ) && i + 1 < textLen && text.at( i + 1 ) == QChar( '*' ) )
+        {
+            int next = text.indexOf( QStringLiteral( "*/" ), i + 2 );
+            if ( next == -1 )
+            {
+                _blockState = _language->id + 1;
+                formatToken( i, textLen - i, CodeComment );
+                markContext( i, textLen, CodeComment );
+                return;
+            }
+            next += 2;
+            formatToken( i, next - i, CodeComment );
+            markContext( i, next, CodeComment );
+            i = next - 1;
+        } else if ( c == comment )
+        {
+            formatToken( i, textLen - i, CodeComment );
+            markContext( i, textLen, CodeComment );
+            return;
+        } else if ( c == QChar( '\"' ) || c == QChar( '\'' ) || ( !multi.isNull() && c == multi ) )
+        {
+            i = highlightStringLiterals( c, text, i ) - 1;
+        }
+    }
+}
+
+void QSourceHighlighter::setCache( QSourceHighlightCache* cache )
+{
+    _cache = cache;
+}
+
+void QSourceHighlighter::setPlainText( const QString& text )
+{
+    if ( document() == nullptr )
+        return;
+    if ( _cache == nullptr || _language == nullptr )
+    {
+        document()->setPlainText( text );
+        return;
+    }
+
+    const QByteArray             key = cacheKey( text );
+    QSourceHighlightCache::Entry entry;
+    _cacheReplay = _cache->load( key, entry );
+    _cacheEntry  = &entry;
+    _cacheLine   = 0;
+    _cacheColor  = 0;
+
+    // highlights all blocks right away
+    document()->setPlainText( text );
+
+    const bool complete = _cacheEntry != nullptr && _cacheLine == document()->blockCount();
+    _cacheEntry         = nullptr;
+    if ( complete && !_cacheReplay )
+        _cache->store( key, entry );
+}
+
+void QSourceHighlighter::setPlainText( const QString& text, const QSourceHighlightCacheEntry& highlighting )
+{
+    if ( document() == nullptr )
+        return;
+    if ( _language == nullptr )
+    {
+        document()->setPlainText( text );
+        return;
+    }
+
+    // the replay only reads the entry, the copy shares its arrays
+    QSourceHighlightCacheEntry entry = highlighting;
+    _cacheReplay                     = true;
+    _cacheEntry                      = &entry;
+    _cacheLine                       = 0;
+    _cacheColor                      = 0;
+    document()->setPlainText( text );
+    _cacheEntry = nullptr;
+}
+
+QByteArray QSourceHighlighter::cacheKey( const QString& text ) const
+{
+    if ( _language == nullptr )
+        return QByteArray();
+    return QSourceHighlightCache::key( text, _language->name, _language->definition->version + _annotationKey, LexerVersion );
+}
+
+void QSourceHighlighter::highlightText( const QString& text, QSourceHighlightCacheEntry& highlighting )
+{
+    typedef QSourceHighlightCacheEntry E;
+
+    highlighting.clear();
+    if ( _language == nullptr )
+        return;
+
+    QVector< Span > spans;
+    int             state    = _language->id;
+    int             position = 0; // in the document, where a line break is one char
+    const int       textLen  = text.length();
+    for ( int start = 0; start <= textLen; )
+    {
+        int end = start;
+        while ( end < textLen && text.at( end ) != QChar( '\n' ) && text.at( end ) != QChar( '\r' ) )
+            ++end;
+
+        spans.clear();
+        state = highlightLine( QString::fromRawData( text.constData() + start, end - start ), state, spans, position );
+        for ( const Span& S : qAsConst( spans ) )
+            highlighting.addItem( S.start, S.length, quint8( E::FormatItem | S.token | ( S.modifiers << 4 ) ), S.color );
+        for ( const ContextSpan& C : qAsConst( _contextSpans ) )
+            highlighting.addItem( position + C.start, C.end - C.start, quint8( E::ContextItem | C.token ) );
+        for ( const QSourceBlockData::Symbol& S : qAsConst( _lineData.symbols ) )
+            highlighting.addItem( position + S.position, S.length, quint8( E::SymbolItem | S.kind ) );
+        highlighting.endLine( state - _language->id );
+
+        position += end - start + 1;
+        if ( end + 1 < textLen && text.at( end ) == QChar( '\r' ) && text.at( end + 1 ) == QChar( '\n' ) )
+            ++end;
+        start = end + 1;
+    }
+}
+
+/**
+ * @brief Add what lexBlock() found in the current block to the cache entry
+ */
+void QSourceHighlighter::recordCachedBlock()
+{
+    typedef QSourceHighlightCacheEntry E;
+
+    const int mode = _blockState - _language->id;
+    if ( mode < 0 || mode >= ALanguage::StateCount )
+    {
+        _cacheEntry = nullptr;
+        return;
+    }
+
+    for ( const Span& S : qAsConst( _cacheSpans ) )
+        _cacheEntry->addItem( S.start, S.length, quint8( E::FormatItem | S.token | ( S.modifiers << 4 ) ), S.color );
+    for ( const ContextSpan& C : qAsConst( _contextSpans ) )
+        _cacheEntry->addItem( _spanOffset + C.start, C.end - C.start, quint8( E::ContextItem | C.token ) );
+    for ( const QSourceBlockData::Symbol& S : qAsConst( _blockData->symbols ) )
+        _cacheEntry->addItem( _spanOffset + S.position, S.length, quint8( E::SymbolItem | S.kind ) );
+    _cacheEntry->endLine( mode );
+    ++_cacheLine;
+}
+
+/**
+ * @brief Restore the current block from the cache entry instead of lexing it
+ */
+void QSourceHighlighter::replayCachedBlock( const QString& text )
+{
+    typedef QSourceHighlightCacheEntry E;
+
+    const E& entry = *_cacheEntry;
+    if ( _cacheLine >= entry.lineCount() )
+    {
+        _cacheEntry = nullptr;
+        lexBlock( text );
+        return;
+    }
+
+    _blockData->clear();
+    _blockData->startState = _blockState;
+    _contextSpans.clear();
+    _textLength = text.length();
+
+    for ( quint32 i = entry.lineItems[ _cacheLine ]; i < entry.lineItems[ _cacheLine + 1 ]; ++i )
+    {
+        const int start = int( entry.offsets[ i ] ) - _spanOffset;
+        const int count = entry.lengths[ i ];
+        const int kind  = entry.kinds[ i ] & 0x0F;
+        switch ( entry.kinds[ i ] & E::ItemTypeMask )
+        {
+            case E::FormatItem:
+            {
+                const int modifiers = ( entry.kinds[ i ] >> 4 ) & 0x03;
+                QRgb      color     = 0;
+                if ( ( modifiers & ColorSwatch ) && _cacheColor < entry.colors.size() )
+                    color = entry.colors[ _cacheColor++ ];
+                if ( kind < TokenCount )
+                    formatToken( start, count, Token( kind ), modifiers, color );
+                break;
+            }
+            case E::ContextItem:
+                if ( kind < TokenCount )
+                    markContext( qMax( 0, start ), qMin( start + count, _textLength ), Token( kind ) );
+                break;
+            case E::SymbolItem:
+                if ( start >= 0 && start + count <= _textLength )
+                    _blockData->symbols.append( QSourceBlockData::Symbol{ start, count, kind } );
+                break;
+        }
+    }
+    _blockState = _language->id + entry.lineStates[ _cacheLine ];
+    ++_cacheLine;
+
+    indexBrackets( text );
+    indexFolds( text );
+}
+
+int QSourceHighlighter::highlightLine( const QString& text, int state, QVector< Span >& spans, int offset )
+{
+    if ( _language == nullptr )
+        return state;
+
+    _headless   = true;
+    _blockState = ( state == -1 ) ? _language->id : state;
+    _blockData  = &_lineData;
+    _spanSink   = &spans;
+    _spanOffset = offset;
+
+    lexBlock( text );
+
+    _headless = false;
+    _spanSink = nullptr;
+    return _blockState;
+}
+
+/**
+ * @brief Format a token of the current block
+ * @param start first char, relative to the block
+ * @param count length, clamped to the block like setFormat()
+ * @param token the theme format to use
+ * @param modifiers FormatModifier flags, see derivedFormat()
+ * @param color the swatch color for ColorSwatch
+ * @details Also records the span when spans are being collected
+ */
+void QSourceHighlighter::formatToken( int start, int count, Token token, int modifiers, QRgb color )
+{
+    if ( start < 0 || start >= _textLength )
+        return;
+    count = qMin( count, _textLength - start );
+    if ( count <= 0 )
+        return;
+
+    if ( !_headless )
+        setFormat( start, count, ( modifiers == NoModifier ) ? _tokenFormats[ token ] : derivedFormat( token, modifiers, color ) );
+    if ( _spanSink != nullptr )
+        _spanSink->append( Span{ _spanOffset + start, count, token, quint8( modifiers ), color } );
+    if ( _segmented || _recordFormats )
+        _blockData->formats.append( QSourceBlockData::Format{ start, count, quint8( token ), quint8( modifiers ), color } );
+    // the block format covers the line, it doesn't make the lexer look ahead
+    if ( _segmented && ( token != CodeBlock || modifiers != NoModifier ) )
+        _formatEnd = qMax( _formatEnd, start + count );
 }
 
 /**
  * @brief Does the code syntax highlighting
  * @param text
+ * @param checkpoint checkpoint of a long line to resume from, see highlightSegmented()
  */
-void QSourceHighlighter::highlightSyntax( const QString& text )
+void QSourceHighlighter::highlightSyntax( const QString& text, int checkpoint )
 {
     if ( text.isEmpty() )
         return;
 
-    if ( _language->name == "xml" )
+    if ( _language->name == QLatin1String( "xml" ) )
     {
         xmlHighlighter( text );
         return;
@@ -136,62 +1510,60 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
 
     const auto textLen = text.length();
 
-    QChar comment = _language->comment;
-    Qt::CaseSensitivity CI      = ( _language->caseInsensitive ) ? Qt::CaseInsensitive : Qt::CaseSensitive;
-    bool  isCSS   = _language->name == "css";
-    bool  isYAML  = _language->name == "yaml";
-    bool  isMake  = _language->name == "make";
-    bool  isAsm   = _language->name == "asm";
+    QChar comment = _language->definition->comment;
+    Qt::CaseSensitivity CI      = ( _language->definition->caseInsensitive ) ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    if ( _hooksLanguage != _language )
+    {
+        _hooksLanguage = _language;
+        _hooks         = languageHooks( _language->name );
+    }
+    // the hooks need the whole line, segments of a long line go without them
+    const LanguageHooks* hooks = _segmented ? nullptr : _hooks;
+    _hookState                 = HookState{ -1, false, false, -2, -2 };
 
     // keep the default code block format
     // this statement is very slow
     // TODO: do this formatting when necessary instead of
     // applying it to the whole block in the beginning
-    setFormat(0, textLen, _theme[CodeBlock]);
+    formatToken( 0, textLen, CodeBlock );
+    // a long line continues from one of its previous checkpoints
+    if ( checkpoint >= 0 )
+        restoreCheckpoint( checkpoint );
+    const int start = ( checkpoint >= 0 ) ? _blockData->checkpoints.last().position : 0;
 
     QStringView ROText( text );
+    // see the shards below
+    bool firstWord   = start == 0;
+    bool instruction = false;
 
     auto applyCodeFormat =
-        [ this, CI, ROText ]( int i, const ALanguage::wordDictionary& data,
-                              const QString& text, const QTextCharFormat& fmt ) -> int {
+        [ this, CI, ROText, &instruction ]( int i, LanguageDefinition::Category category, Token token ) -> int {
         // check if we are at the beginning OR if this is the start of a word
-        if ( i == 0 || ( !text.at( i - 1 ).isLetterOrNumber() && text.at( i - 1 ) != QChar( '_' ) ) )
+        if ( i == 0 || !isWordChar( ROText.at( i - 1 ) ) )
         {
-
-            const auto wordList = data.values( ( ( CI == Qt::CaseInsensitive ) ? ROText.at( i ).toLower() : ROText.at( i ) ) );
-            for ( const QString& word : wordList )
+            const int length = _language->definition->match( category, ROText, i, CI, isWordChar, instruction );
+            if ( length > 0 )
             {
-                // we have a word match check
-                // 1. if we are at the end
-                // 2. if we have a complete word
-                if ( text.mid( i, word.size() ).compare( word, CI ) == 0 && ( i + word.size() == text.length() || ( !text.at( i + word.size() ).isLetterOrNumber() && text.at( i + word.size() ) != QChar( '_' ) ) ) )
-                {
-                    setFormat( i, word.size(), fmt );
-                    i += word.size();
-                }
+                formatToken( i, length, token );
+                i += length;
             }
         }
         return i;
     };
 
-    const QTextCharFormat &formatType = _theme[CodeType];
-    const QTextCharFormat &formatKeyword = _theme[CodeKeyWord];
-    const QTextCharFormat &formatComment = _theme[CodeComment];
-    const QTextCharFormat &formatNumLit = _theme[CodeNumLiteral];
-    const QTextCharFormat &formatBuiltIn = _theme[CodeBuiltIn];
-    const QTextCharFormat &formatOther = _theme[CodeOther];
-
-    for ( int i = 0; i < textLen; ++i )
+    for ( int i = start; i < textLen; ++i )
     {
+        if ( i >= _nextCheckpoint )
+            addCheckpoint( text, i );
 
-        if ( currentBlockState() % 3 == 1 )
+        if ( _blockState == _language->id + 1 )
         {
             goto Comment;
         }
 
-        if ( currentBlockState() % 3 == 2 )
+        if ( _blockState == _language->id + 2 )
         {
-            i = highlightStringLiterals( _language->multilinestringchar, text, i );
+            i = highlightStringLiterals( _language->definition->multilinestringchar, text, i );
         }
 
         while ( i < textLen && !text[ i ].isLetter() )
@@ -214,20 +1586,21 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
                 {
                     if ( text[ i + 1 ] == QChar( '/' ) )
                     {
-                        setFormat( i, textLen, formatComment );
+                        formatToken( i, textLen, CodeComment );
+                        markContext( i, textLen, CodeComment );
                         return;
                     } else if ( text[ i + 1 ] == QChar( '*' ) )
                     {
                     Comment:
-                        int next = text.indexOf( QStringLiteral( "*/" ) );
+                        // when continuing a comment from the previous block the
+                        // end marker may be right at i, otherwise skip the "/*"
+                        int next = text.indexOf( QStringLiteral( "*/" ), ( _blockState == _language->id + 1 ) ? i : i + 2 );
                         if (next == -1) {
                             //we didn't find a comment end.
-                            //Check if we are already in a comment block
-                            if ( currentBlockState() % 3 == 1 )
-                            {
-                                setCurrentBlockState( _language->id + 1 );
-                            }
-                            setFormat(i, textLen,  formatComment);
+                            //mark this block as comment so the next one continues it
+                            _blockState = _language->id + 1;
+                            formatToken(i, textLen,  CodeComment);
+                            markContext( i, textLen, CodeComment );
                             return;
                         } else {
                             //we found a comment end
@@ -235,12 +1608,13 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
                             //first check if the comment ended on the same line
                             //if modulo 2 is not equal to zero, it means we are in a comment
                             //-1 will set this block's state as language
-                            if ( currentBlockState() % 3 == 0 )
+                            if ( _blockState == _language->id + 1 )
                             {
-                                setCurrentBlockState( _language->id );
+                                _blockState = _language->id;
                             }
                             next += 2;
-                            setFormat(i, next - i,  formatComment);
+                            formatToken(i, next - i,  CodeComment);
+                            markContext( i, next, CodeComment );
                             i = next;
                             if (i >= textLen) return;
                         }
@@ -248,7 +1622,8 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
                 }
             } else if ( text[ i ] == comment )
             {
-                setFormat( i, textLen, formatComment );
+                formatToken( i, textLen, CodeComment );
+                markContext( i, textLen, CodeComment );
                 i = textLen;
                 //integer lighteral
             } else if ( text[ i ].isNumber() )
@@ -258,12 +1633,17 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
             } else if ( text[ i ] == QChar( '\"' ) )
             {
                 i = highlightStringLiterals( '\"', text, i );
-            } else if ( text[ i ] == _language->multilinestringchar )
+            } else if ( text[ i ] == _language->definition->multilinestringchar )
             {
-                i = highlightStringLiterals( _language->multilinestringchar, text, i );
+                i = highlightStringLiterals( _language->definition->multilinestringchar, text, i );
             } else if ( text[ i ] == QChar( '\'' ) )
             {
                 i = highlightStringLiterals( '\'', text, i );
+            } else if ( hooks != nullptr && hooks->onChar != nullptr )
+            {
+                const int next = ( this->*hooks->onChar )( ROText, i );
+                if ( next > i )
+                    i = next - 1;
             }
             if (i >= textLen) {
                 break;
@@ -275,77 +1655,90 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
 
         if (i == textLen || !text[i].isLetter()) continue;
 
-        /* Highlight Types */
-        i = applyCodeFormat( i, _language->types, text, formatType );
-        /************************************************
-         next letter is usually a space, in that case
-         going forward is useless, so continue;
-         We can ++i here and go to the beginning of the next word
-         so that the next formatter can check for formatting but this will
-         cause problems in case the next word is also of 'Type' or the current
-         type(keyword/builtin). We can work around it and reset the value of i
-         in the beginning of the loop to the word's first letter but I am not
-         sure about its efficiency yet.
-         ************************************************/
-        if (i == textLen || !text[i].isLetter()) continue;
-
-        /* Highlight Keywords */
-        i = applyCodeFormat( i, _language->keywords, text, formatKeyword );
-        if (i == textLen || !text[i].isLetter()) continue;
-
-        /* Highlight Literals (true/false/NULL,nullptr) */
-        i = applyCodeFormat(i, _language->literals, text, formatNumLit);
-        if (i == textLen || !text[i].isLetter()) continue;
-
-        /* Highlight Builtin library stuff */
-        i = applyCodeFormat( i, _language->builtin, text, formatBuiltIn );
-        if (i == textLen || !text[i].isLetter()) continue;
+        // the word may be in a dialect, e.g. an AVX instruction in asm. Only
+        // the first word of a line can be one, after blanks or a label, not an
+        // operand, a label or a directive such as ".fill". Elsewhere the words
+        // of the shards aren't looked up, so the highlighting doesn't depend
+        // on the shards other documents loaded
+        instruction = false;
+        if ( firstWord )
+        {
+            int wordEnd = pos;
+            while ( wordEnd < textLen && isWordChar( text[ wordEnd ] ) )
+                ++wordEnd;
+            const bool label = wordEnd < textLen && text[ wordEnd ] == QChar( ':' );
+            instruction      = !label && ( pos == 0 || text[ pos - 1 ].isSpace() );
+            firstWord        = label;
+        }
 
-        /* Highlight other stuff (preprocessor etc.) */
-        if ( ( i == 0 || !text.at( i - 1 ).isLetter() ) && _language->others.contains( ( ( CI == Qt::CaseInsensitive ) ? ROText.at( i ).toLower() : ROText.at( i ) ) ) )
+        bool missed = false;
+        do
         {
-            const QList< QString > wordList = _language->others.values( ( ( CI == Qt::CaseInsensitive ) ? ROText.at( i ).toLower() : ROText.at( i ) ) );
-            for ( const QString& word : wordList )
+            /* Highlight Types */
+            i = applyCodeFormat( i, LanguageDefinition::Types, CodeType );
+            /************************************************
+             next letter is usually a space, in that case
+             going forward is useless, so continue;
+             We can ++i here and go to the beginning of the next word
+             so that the next formatter can check for formatting but this will
+             cause problems in case the next word is also of 'Type' or the current
+             type(keyword/builtin). We can work around it and reset the value of i
+             in the beginning of the loop to the word's first letter but I am not
+             sure about its efficiency yet.
+             ************************************************/
+            if (i == textLen || !text[i].isLetter()) break;
+
+            /* Highlight Keywords */
+            i = applyCodeFormat( i, LanguageDefinition::Keywords, CodeKeyWord );
+            if (i == textLen || !text[i].isLetter()) break;
+
+            /* Highlight Literals (true/false/NULL,nullptr) */
+            i = applyCodeFormat( i, LanguageDefinition::Literals, CodeNumLiteral );
+            if (i == textLen || !text[i].isLetter()) break;
+
+            /* Highlight Builtin library stuff */
+            i = applyCodeFormat( i, LanguageDefinition::Builtin, CodeBuiltIn );
+            if (i == textLen || !text[i].isLetter()) break;
+
+            /* Highlight other stuff (preprocessor etc.) */
+            if ( i == 0 || !text.at( i - 1 ).isLetter() )
             {
-                if ( ROText.mid( i, word.size() ).compare( word ) == 0 // we have a word match
-                     && ( i + word.size() == text.length()             // check if we are at the end
-                          || !text.at( i + word.size() ).isLetter() )  //OR if we have a complete word
-                )
+                const int length = _language->definition->match( LanguageDefinition::Others, ROText, i, Qt::CaseSensitive, isLetter, instruction );
+                if ( length > 0 )
                 {
-                    ( currentBlockState() == CppID ) ?
-                        setFormat( i - 1, word.size() + 1, formatOther ) :
-                        setFormat( i, word.size(), formatOther );
-                    i += word.size();
+                    ( _blockState == CppID ) ?
+                        formatToken( i - 1, length + 1, CodeOther ) :
+                        formatToken( i, length, CodeOther );
+                    i += length;
                 }
             }
-        }
 
-        //we were unable to find any match, lets skip this word
-        if (pos == i) {
-            int count = i;
-            while (count < textLen) {
-                if (!text[count].isLetter()) break;
-                ++count;
+            //we were unable to find any match, lets skip this word
+            if (pos == i) {
+                int count = i;
+                while (count < textLen) {
+                    if (!text[count].isLetter()) break;
+                    ++count;
+                }
+                i = count;
+                missed = true;
             }
-            i = count;
+        } while ( false );
+
+        // an instruction whose shard isn't loaded yet, look it up again once it is
+        if ( missed && instruction && _language->definition->loadShardFor( ROText.mid( pos, i - pos ), CI ) )
+        {
+            i         = pos - 1;
+            firstWord = true;
+            continue;
         }
-    }
 
-    if ( isCSS )
-    {
-        cssHighlighter( text );
-    }
-    if ( isYAML )
-    {
-        ymlHighlighter( text );
-    }
-    if ( isMake )
-    {
-        makeHighlighter( text );
-    }
-    if ( isAsm )
-    {
-        asmHighlighter( text );
+        if ( hooks != nullptr && hooks->onWord != nullptr )
+        {
+            const int next = ( this->*hooks->onWord )( ROText, pos, i );
+            if ( next > i )
+                i = next - 1;
+        }
     }
 }
 
@@ -357,8 +1750,9 @@ void QSourceHighlighter::highlightSyntax( const QString& text )
  * @return pos of i after the string
  */
 int QSourceHighlighter::highlightStringLiterals(const QChar strType, const QString &text, int i) {
+    const int start = i;
     bool stringClosed = false;
-    setFormat(i, 1, _theme[CodeString]);
+    _escapes.clear();
     ++i;
 
     while (i < text.length()) {
@@ -366,7 +1760,6 @@ int QSourceHighlighter::highlightStringLiterals(const QChar strType, const QStri
         //make sure it's not an escape seq
         if ( text.at( i ) == strType && text.at( i - 1 ) != QChar( '\\' ) )
         {
-            setFormat(i, 1, _theme[CodeString]);
             ++i;
             stringClosed = true;
             break;
@@ -417,7 +1810,7 @@ int QSourceHighlighter::highlightStringLiterals(const QChar strType, const QStri
                 }
                 //hex numbers \xFA
                 case 'x': {
-                    if ( i + 3 <= text.length() )
+                    if ( i + 4 <= text.length() )
                     {
                         if ( !isHex( text.at( i + 2 ) ) )
                         {
@@ -431,29 +1824,808 @@ int QSourceHighlighter::highlightStringLiterals(const QChar strType, const QStri
                     }
                     break;
                 }
-                //TODO: implement unicode code point escaping
-                default:
-                    break;
+                //TODO: implement unicode code point escaping
+                default:
+                    break;
+            }
+
+            //if len is zero, that means this wasn't an esc seq
+            //increment i so that we skip this backslash
+            if (len == 0) {
+                    ++i;
+                    continue;
+            }
+
+            _escapes.append(qMakePair(i, len));
+            i += len;
+            continue;
+        }
+        ++i;
+    }
+
+    // one span for the string, then the escape sequences on top of it
+    formatToken(start, i - start, CodeString);
+    for (const auto &escape : qAsConst(_escapes))
+        formatToken(escape.first, escape.second, CodeNumLiteral);
+
+    _blockState = _language->id + ( ( !stringClosed ) ? 2 : 0 );
+    markContext( start, i, CodeString );
+    return i;
+}
+
+/**
+ * @brief Remember a string or comment found while lexing the current block
+ * @param start first char of the span
+ * @param end one past the last char of the span
+ * @param token CodeString or CodeComment
+ */
+void QSourceHighlighter::markContext( int start, int end, Token token )
+{
+    if ( end > start )
+    {
+        _contextSpans.append( ContextSpan{ start, end, token } );
+    }
+}
+
+/**
+ * @brief Highlight the annotations in the strings and comments of the block
+ * @details One pass of the automaton over each span collected by
+ * markContext(), the extent of a match is only checked once it is found.
+ */
+void QSourceHighlighter::annotate( const QString& text )
+{
+    if ( _annotationMatcher.isNull() || _contextSpans.isEmpty() )
+        return;
+
+    const QChar* data = text.constData();
+    for ( const ContextSpan& C : qAsConst( _contextSpans ) )
+    {
+        const int first = C.start;
+        const int last  = C.end;
+        _annotationMatcher->scan( data, first, last, [ this, data, first, last ]( int pattern, int end ) -> int {
+            const Annotation& A     = _annotations.at( pattern );
+            const int         start = end - A.pattern.length();
+            switch ( A.extent )
+            {
+                case AnnotationWord:
+                    if ( ( start > first && isWordChar( data[ start - 1 ] ) ) || ( end < last && isWordChar( data[ end ] ) ) )
+                        return -1;
+                    break;
+                case AnnotationLink:
+                    while ( end < last && !endsLink( data[ end ] ) )
+                        ++end;
+                    while ( end > start + A.pattern.length() && trailsLink( data[ end - 1 ] ) )
+                        --end;
+                    if ( end == start + A.pattern.length() )
+                        return -1;
+                    break;
+                case AnnotationNumber:
+                {
+                    const int digits = end;
+                    if ( start > first && isWordChar( data[ start - 1 ] ) )
+                        return -1;
+                    while ( end < last && data[ end ].isDigit() )
+                        ++end;
+                    if ( end == digits || ( end < last && isWordChar( data[ end ] ) ) )
+                        return -1;
+                    break;
+                }
+            }
+            formatToken( start, end - start, A.token, A.modifiers );
+            return end;
+        } );
+    }
+}
+
+void QSourceHighlighter::setAnnotations( const QVector< Annotation >& annotations )
+{
+    _annotations       = annotations;
+    _annotationMatcher = annotationMatcher( annotations );
+    _annotationKey     = annotationKey( annotations );
+    requestRehighlight();
+}
+
+QVector< QSourceHighlighter::Annotation > QSourceHighlighter::annotations() const
+{
+    return _annotations;
+}
+
+QVector< QSourceHighlighter::Annotation > QSourceHighlighter::defaultAnnotations()
+{
+    return { { QStringLiteral( "TODO" ), AnnotationWord, CodeKeyWord, NoModifier },
+             { QStringLiteral( "FIXME" ), AnnotationWord, CodeKeyWord, NoModifier },
+             { QStringLiteral( "XXX" ), AnnotationWord, CodeKeyWord, NoModifier },
+             { QStringLiteral( "http://" ), AnnotationLink, CodeBuiltIn, Underline },
+             { QStringLiteral( "https://" ), AnnotationLink, CodeBuiltIn, Underline },
+             { QStringLiteral( "#" ), AnnotationNumber, CodeBuiltIn, Underline } };
+}
+
+/**
+ * @brief Merge the semantic tokens of the current block over its lexical formats
+ */
+void QSourceHighlighter::mergeOverlays( const QString& text )
+{
+    if ( _blockData->overlayHash != uint( qHash( text ) ) )
+    {
+        _blockData->overlays.clear();
+        return;
+    }
+    for ( const QSourceBlockData::Overlay& O : _blockData->overlays.overlays() )
+    {
+        QTextCharFormat f = format( O.start );
+        f.merge( _semanticFormats.value( O.type ) );
+        setFormat( O.start, O.end - O.start, f );
+    }
+}
+
+/**
+ * @brief Update the formats of block after its overlays changed
+ * @details The lexical formats recorded when the block was lexed are
+ * replayed with the overlays merged over them and set on the layout, as
+ * QSyntaxHighlighter would. A block lexed without recording is lexed again.
+ */
+void QSourceHighlighter::applyOverlays( const QTextBlock& block )
+{
+    const auto* D = blockData( block );
+    if ( D == nullptr || D->pending )
+        return; // merged when the block is lexed
+    const int length = block.length() - 1;
+    if ( D->overlayHash != uint( qHash( block.text() ) ) )
+        return; // the text changed since, the block is lexed again anyway
+    if ( D->formats.isEmpty() || length <= 0 )
+    {
+        if ( length > 0 )
+            rehighlightBlock( block );
+        return;
+    }
+
+    QVector< QTextCharFormat > chars( length );
+    for ( const QSourceBlockData::Format& F : D->formats )
+    {
+        const QTextCharFormat& f = ( F.modifiers == NoModifier ) ? _tokenFormats[ F.token ] : derivedFormat( Token( F.token ), F.modifiers, F.color );
+        std::fill( chars.begin() + qMin( F.start, length ), chars.begin() + qMin( F.start + F.length, length ), f );
+    }
+    for ( const QSourceBlockData::Overlay& O : D->overlays.overlays() )
+    {
+        if ( O.start >= length )
+            break;
+        QTextCharFormat f = chars.at( O.start );
+        f.merge( _semanticFormats.value( O.type ) );
+        std::fill( chars.begin() + O.start, chars.begin() + qMin( O.end, length ), f );
+    }
+
+    QVector< QTextLayout::FormatRange > ranges;
+    for ( int i = 0; i < length; )
+    {
+        int end = i + 1;
+        while ( end < length && chars.at( end ) == chars.at( i ) )
+            ++end;
+        if ( chars.at( i ).isValid() )
+            ranges.append( QTextLayout::FormatRange{ i, end - i, chars.at( i ) } );
+        i = end;
+    }
+    block.layout()->setFormats( ranges );
+}
+
+void QSourceHighlighter::setSemanticFormat( int type, const QTextCharFormat& format )
+{
+    _semanticFormats.insert( type, format );
+}
+
+void QSourceHighlighter::setSemanticTokens( int from, int to, const QVector< SemanticToken >& tokens )
+{
+    if ( document() == nullptr )
+        return;
+
+    QVector< SemanticToken > sorted = tokens;
+    std::sort( sorted.begin(), sorted.end(), []( const SemanticToken& A, const SemanticToken& B ) { return A.position < B.position; } );
+
+    beginSemanticUpdate();
+    int t = 0;
+    for ( QTextBlock B = document()->findBlock( from ); B.isValid() && B.position() < to; B = B.next() )
+    {
+        const int start = B.position();
+        const int end   = start + B.length() - 1;
+        auto*     D     = static_cast< QSourceBlockData* >( B.userData() );
+        if ( D == nullptr )
+        {
+            if ( sorted.isEmpty() )
+                continue;
+            D = new QSourceBlockData;
+            B.setUserData( D );
+        }
+
+        // the overlays of the block outside of the range stay
+        const int                          first = qMax( from, start ) - start;
+        const int                          last  = qMin( to, end + 1 ) - start;
+        QVector< QSourceBlockData::Overlay > kept;
+        for ( const QSourceBlockData::Overlay& O : D->overlays.overlays() )
+        {
+            if ( O.end <= first || O.start >= last )
+                kept.append( O );
+        }
+        const bool changed = kept.size() != D->overlays.overlays().size();
+
+        while ( t < sorted.size() && sorted.at( t ).position + sorted.at( t ).length <= start )
+            ++t;
+        for ( int k = t; k < sorted.size() && sorted.at( k ).position < end; ++k )
+        {
+            const SemanticToken& T = sorted.at( k );
+            const int            s = qMax( T.position, start + first ) - start;
+            const int            e = qMin( T.position + T.length, start + last ) - start;
+            if ( e > s )
+                kept.append( QSourceBlockData::Overlay{ s, e, T.type } );
+        }
+        if ( !changed && kept.size() == D->overlays.overlays().size() )
+            continue;
+
+        D->overlays.assign( kept );
+        D->overlayHash = uint( qHash( B.text() ) );
+        _overlaysChanged.append( B );
+    }
+    endSemanticUpdate();
+}
+
+QVector< QSourceHighlighter::SemanticToken > QSourceHighlighter::semanticTokens( int from, int to ) const
+{
+    QVector< SemanticToken > tokens;
+    if ( document() == nullptr )
+        return tokens;
+
+    for ( QTextBlock B = document()->findBlock( from ); B.isValid() && B.position() < to; B = B.next() )
+    {
+        const auto* D = blockData( B );
+        if ( D == nullptr )
+            continue;
+        const int start = B.position();
+        D->overlays.overlapping( from - start, to - start, [ &tokens, start ]( const QSourceBlockData::Overlay& O ) {
+            tokens.append( SemanticToken{ start + O.start, O.end - O.start, O.type } );
+        } );
+    }
+    return tokens;
+}
+
+void QSourceHighlighter::clearSemanticTokens()
+{
+    if ( document() != nullptr )
+        setSemanticTokens( 0, document()->characterCount(), QVector< SemanticToken >() );
+}
+
+void QSourceHighlighter::beginSemanticUpdate()
+{
+    ++_semanticUpdates;
+}
+
+void QSourceHighlighter::endSemanticUpdate()
+{
+    if ( _semanticUpdates == 0 || --_semanticUpdates > 0 || _overlaysChanged.isEmpty() )
+        return;
+
+    // blocks changed by several calls are applied once, and the layout is
+    // told about the whole range at once
+    int first = INT_MAX;
+    int last  = 0;
+    QVector< QTextBlock > blocks;
+    blocks.swap( _overlaysChanged );
+    std::sort( blocks.begin(), blocks.end(), []( const QTextBlock& A, const QTextBlock& B ) { return A.position() < B.position(); } );
+    blocks.erase( std::unique( blocks.begin(), blocks.end() ), blocks.end() );
+    for ( const QTextBlock& B : qAsConst( blocks ) )
+    {
+        if ( !B.isValid() )
+            continue;
+        applyOverlays( B );
+        first = qMin( first, B.position() );
+        last  = qMax( last, B.position() + B.length() );
+    }
+    if ( first < last )
+        document()->markContentsDirty( first, last - first );
+}
+
+/**
+ * @brief Record the brackets of the current block that are in code context,
+ * and its identifiers when they are indexed
+ * @param text the text of the block
+ * @details The strings and comments collected by markContext() are skipped,
+ * so brackets and identifiers in them are never found. Runs once over the block.
+ */
+void QSourceHighlighter::indexBrackets( const QString& text )
+{
+    const int  textLen     = text.length();
+    const bool identifiers = _identifierIndex != nullptr && !_headless;
+    int        span        = 0;
+
+    for ( int i = 0; i < textLen; ++i )
+    {
+        while ( span < _contextSpans.size() && _contextSpans[ span ].end <= i )
+            ++span;
+        if ( span < _contextSpans.size() && _contextSpans[ span ].start <= i )
+        {
+            i = _contextSpans[ span ].end - 1;
+            continue;
+        }
+
+        const QChar c = text[ i ];
+        if ( identifiers && ( c.isLetter() || c == QChar( '_' ) ) && ( i == 0 || !isWordChar( text[ i - 1 ] ) ) )
+        {
+            // strings and comments never start inside a word
+            int end = i + 1;
+            while ( end < textLen && isWordChar( text[ end ] ) )
+                ++end;
+            _blockData->identifiers.append( QSourceBlockData::Identifier{ i, end - i, uint( qHash( QStringView( text ).mid( i, end - i ) ) ) } );
+            i = end - 1;
+            continue;
+        }
+
+        bool       open = false;
+        const auto kind = QSourceBlockData::bracketKind( c, open );
+        if ( kind != QSourceBlockData::BracketKindCount )
+            _blockData->addBracket( i, kind, open );
+    }
+}
+
+int QSourceHighlighter::matchingBracket( int position ) const
+{
+    const QTextBlock block = document()->findBlock( position );
+    auto*            data  = static_cast< QSourceBlockData* >( block.userData() );
+    if ( data == nullptr )
+        return -1;
+
+    const int index = data->bracketAt( position - block.position() );
+    if ( index == -1 )
+        return -1;
+
+    const QSourceBlockData::BracketKind kind    = data->brackets[ index ].kind;
+    const bool                          forward = data->brackets[ index ].open;
+
+    // depth counts the brackets still waiting for their partner
+    int depth = 1;
+
+    // finish the block of the bracket itself
+    auto scanBlock = [ kind, forward, &depth ]( const QSourceBlockData* D, int from ) -> int {
+        const int step = forward ? 1 : -1;
+        for ( int j = from; j >= 0 && j < D->brackets.size(); j += step )
+        {
+            const QSourceBlockData::Bracket& B = D->brackets[ j ];
+            if ( B.kind != kind )
+                continue;
+            depth += ( B.open == forward ) ? 1 : -1;
+            if ( depth == 0 )
+                return B.position;
+        }
+        return -1;
+    };
+
+    int found = scanBlock( data, forward ? index + 1 : index - 1 );
+    if ( found != -1 )
+        return block.position() + found;
+
+    QTextBlock B = forward ? block.next() : block.previous();
+    while ( B.isValid() )
+    {
+        auto* D = static_cast< QSourceBlockData* >( B.userData() );
+        if ( D != nullptr && !D->brackets.isEmpty() )
+        {
+            // the running depth inside this block never reaches zero, skip it
+            // going backwards the deepest point is measured from the block end
+            const int reach = forward ? D->minDepth[ kind ] : D->minDepth[ kind ] - D->depthDelta[ kind ];
+            if ( depth + reach > 0 )
+            {
+                depth += forward ? D->depthDelta[ kind ] : -D->depthDelta[ kind ];
+            } else
+            {
+                found = scanBlock( D, forward ? 0 : D->brackets.size() - 1 );
+                if ( found != -1 )
+                    return B.position() + found;
+            }
+        }
+        B = forward ? B.next() : B.previous();
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Record the fold markers of the current block
+ * @param text the text of the block
+ * @details Python and YAML only keep the indentation of the block. Other
+ * languages count a region for every brace in code, every multi-line
+ * comment and every region marker comment such as "// region", or directive
+ * such as "#region" or "#pragma region", and their "endregion" counterparts.
+ */
+void QSourceHighlighter::indexFolds( const QString& text )
+{
+    const int textLen = text.length();
+    int       first   = 0;
+    while ( first < textLen && text[ first ].isSpace() )
+        ++first;
+
+    if ( usesIndentFolding() )
+    {
+        // blank and comment only lines don't take part in indentation folding
+        const bool commentOnly = !_contextSpans.isEmpty() && _contextSpans.first().start == first
+                                 && _contextSpans.first().token == CodeComment;
+        if ( first < textLen && !commentOnly )
+            _blockData->indent = first;
+        return;
+    }
+
+    const bool startsInComment = _blockData->startState == _language->id + 1;
+    const bool endsInComment   = _blockState == _language->id + 1;
+
+    if ( startsInComment && !endsInComment )
+        _blockData->addFold( false );
+
+    // region markers are comments, or directives where '#' starts one and
+    // not a comment, code such as "*region = 0;" or "--region;" isn't one
+    bool markerLine = false;
+    if ( !_contextSpans.isEmpty() )
+    {
+        const ContextSpan& S = _contextSpans.first();
+        markerLine           = S.token == CodeComment && S.start <= first && S.end > first;
+    }
+    if ( !markerLine && first < textLen && text[ first ] == QChar( '#' ) )
+        markerLine = _language->definition->comment.isNull();
+
+    int i = first;
+    while ( markerLine && i < textLen
+            && ( text[ i ] == QChar( '/' ) || text[ i ] == QChar( '#' ) || text[ i ] == QChar( '-' )
+                 || text[ i ] == QChar( ';' ) || text[ i ] == QChar( '*' ) || text[ i ].isSpace() ) )
+        ++i;
+    if ( i > first )
+    {
+        QStringView marker = QStringView( text ).mid( i );
+        if ( marker.startsWith( QLatin1String( "pragma" ) ) )
+        {
+            marker = marker.mid( 6 ).trimmed();
+        }
+        auto isMarker = [ &marker ]( QLatin1String word ) {
+            return marker.startsWith( word, Qt::CaseInsensitive )
+                   && ( marker.size() == word.size() || !marker.at( word.size() ).isLetterOrNumber() );
+        };
+        if ( isMarker( QLatin1String( "region" ) ) )
+            _blockData->addFold( true );
+        else if ( isMarker( QLatin1String( "endregion" ) ) )
+            _blockData->addFold( false );
+    }
+
+    for ( const QSourceBlockData::Bracket& B : _blockData->brackets )
+    {
+        if ( B.kind == QSourceBlockData::Curly )
+            _blockData->addFold( B.open );
+    }
+
+    if ( endsInComment && !startsInComment )
+        _blockData->addFold( true );
+}
+
+bool QSourceHighlighter::usesIndentFolding() const
+{
+    // by definition, the language keys are names like "py"
+    if ( _language == nullptr )
+        return false;
+    const QString& name = _language->definition->name;
+    return name == QLatin1String( "python" ) || name == QLatin1String( "yaml" );
+}
+
+/**
+ * @brief Forget the fold levels from blockNumber on and notify the gutter
+ */
+void QSourceHighlighter::invalidateFolds( int blockNumber )
+{
+    blockNumber      = qMax( 0, blockNumber );
+    _foldValid       = qMin( _foldValid, blockNumber );
+    _foldChangedFrom = ( _foldChangedFrom == -1 ) ? blockNumber : qMin( _foldChangedFrom, blockNumber );
+    scheduleIndexSignals();
+}
+
+/**
+ * @brief Remember that the symbols of firstBlock to lastBlock changed
+ * @param lastBlock -1 up to the end of the document
+ */
+void QSourceHighlighter::markSymbolsChanged( int firstBlock, int lastBlock )
+{
+    if ( _symbolsChangedFrom == -1 )
+    {
+        _symbolsChangedFrom = firstBlock;
+        _symbolsChangedTo   = lastBlock;
+    } else
+    {
+        _symbolsChangedFrom = qMin( _symbolsChangedFrom, firstBlock );
+        _symbolsChangedTo   = ( _symbolsChangedTo == -1 || lastBlock == -1 ) ? -1 : qMax( _symbolsChangedTo, lastBlock );
+    }
+    scheduleIndexSignals();
+}
+
+/**
+ * @brief Queue the change signals of the block indexes
+ * @details A rehighlight of many blocks results in a single signal of each
+ * kind, sent once control returns to the event loop.
+ */
+void QSourceHighlighter::scheduleIndexSignals()
+{
+    // a highlighter without document has nothing to notify
+    if ( _indexSignalPending || document() == nullptr )
+        return;
+
+    _indexSignalPending = true;
+    QMetaObject::invokeMethod(
+        this, [ this ]() { flushIndexSignals(); }, Qt::QueuedConnection );
+}
+
+void QSourceHighlighter::flushIndexSignals()
+{
+    _indexSignalPending = false;
+
+    if ( _foldChangedFrom != -1 )
+    {
+        const int from   = _foldChangedFrom;
+        _foldChangedFrom = -1;
+        emit foldingChanged( from );
+    }
+    if ( _symbolsChangedFrom != -1 )
+    {
+        const int from      = _symbolsChangedFrom;
+        const int to        = _symbolsChangedTo;
+        _symbolsChangedFrom = -1;
+        _symbolsChangedTo   = -1;
+        emit symbolsChanged( from, to );
+    }
+}
+
+QVector< QSourceHighlighter::Symbol > QSourceHighlighter::symbols( int firstBlock, int lastBlock ) const
+{
+    QVector< Symbol > result;
+
+    QTextBlock B = document()->findBlockByNumber( qMax( 0, firstBlock ) );
+    for ( int n = qMax( 0, firstBlock ); B.isValid() && ( lastBlock == -1 || n <= lastBlock ); B = B.next(), ++n )
+    {
+        const QSourceBlockData* D = blockData( B );
+        if ( D == nullptr || D->symbols.isEmpty() )
+            continue;
+
+        const QString text = B.text();
+        for ( const QSourceBlockData::Symbol& S : D->symbols )
+        {
+            result.append( Symbol{ B.position() + S.position, S.length, SymbolKind( S.kind ), text.mid( S.position, S.length ) } );
+        }
+    }
+
+    return result;
+}
+
+void QSourceHighlighter::setIdentifierIndexEnabled( bool enabled )
+{
+    if ( enabled == ( _identifierIndex != nullptr ) )
+        return;
+
+    if ( enabled )
+    {
+        _identifierIndex.reset( new QSourceIdentifierIndex );
+        requestRehighlight();
+        return;
+    }
+
+    _identifierIndex.reset();
+    if ( document() == nullptr )
+        return;
+    for ( QTextBlock B = document()->firstBlock(); B.isValid(); B = B.next() )
+    {
+        auto* D = static_cast< QSourceBlockData* >( B.userData() );
+        if ( D != nullptr )
+            D->identifiers = QVector< QSourceBlockData::Identifier >();
+    }
+}
+
+bool QSourceHighlighter::identifierIndexEnabled() const
+{
+    return _identifierIndex != nullptr;
+}
+
+QString QSourceHighlighter::identifierAt( int position ) const
+{
+    if ( document() == nullptr )
+        return QString();
+    const QTextBlock        block = document()->findBlock( position );
+    const QSourceBlockData* data  = blockData( block );
+    if ( data == nullptr )
+        return QString();
+
+    const int offset = position - block.position();
+    auto      it     = std::upper_bound( data->identifiers.cbegin(), data->identifiers.cend(), offset,
+                                []( int p, const QSourceBlockData::Identifier& I ) { return p < I.position; } );
+    if ( it == data->identifiers.cbegin() )
+        return QString();
+    --it;
+    // the end of an identifier counts too, that's where the cursor is after typing it
+    if ( offset > it->position + it->length )
+        return QString();
+    return block.text().mid( it->position, it->length );
+}
+
+QVector< int > QSourceHighlighter::occurrences( const QString& identifier ) const
+{
+    QVector< int > result;
+    if ( _identifierIndex == nullptr || identifier.isEmpty() )
+        return result;
+
+    const uint                      hash   = uint( qHash( QStringView( identifier ) ) );
+    const QSet< QSourceBlockData* > blocks = _identifierIndex->find( hash );
+    for ( const QSourceBlockData* D : blocks )
+    {
+        if ( !D->block.isValid() )
+            continue;
+        // the hash only narrows down the blocks, the text decides
+        const QString text     = D->block.text();
+        const int     position = D->block.position();
+        for ( const QSourceBlockData::Identifier& I : D->identifiers )
+        {
+            if ( I.hash == hash && I.length == identifier.length() && QStringView( text ).mid( I.position, I.length ) == QStringView( identifier ) )
+                result.append( position + I.position );
+        }
+    }
+    std::sort( result.begin(), result.end() );
+    return result;
+}
+
+/**
+ * @brief Record a symbol found in the current block
+ * @param start first char of the symbol in the block
+ * @param end one past the last char of the symbol
+ */
+void QSourceHighlighter::addSymbol( TextValue text, int start, int end, SymbolKind kind )
+{
+    while ( start < end && text.at( start ).isSpace() )
+        ++start;
+    while ( end > start && text.at( end - 1 ).isSpace() )
+        --end;
+    if ( end > start )
+        _blockData->symbols.append( QSourceBlockData::Symbol{ start, end - start, int( kind ) } );
+}
+
+/**
+ * @brief Compute the fold levels of the blocks up to upTo
+ * @details Starts from the first block that isn't known to be valid, so
+ * after an edit only the blocks following it are visited.
+ */
+void QSourceHighlighter::updateFoldLevels( int upTo ) const
+{
+    const QTextDocument* doc = document();
+    _foldValid               = qMin( _foldValid, doc->blockCount() );
+    if ( upTo < _foldValid )
+        return;
+
+    _foldLevels.resize( doc->blockCount() );
+
+    const bool indentFolding = usesIndentFolding();
+    int        n             = _foldValid;
+    QTextBlock B             = doc->findBlockByNumber( n );
+    int        level         = 0;
+    // indentations of the enclosing blocks in indentation folding
+    QVector< int > indents;
+
+    if ( n > 0 )
+    {
+        QTextBlock P = B.previous();
+        if ( indentFolding )
+        {
+            int bound = INT_MAX;
+            for ( ; P.isValid() && bound > 0; P = P.previous() )
+            {
+                const QSourceBlockData* D = blockData( P );
+                if ( D && D->indent >= 0 && D->indent < bound )
+                {
+                    indents.prepend( D->indent );
+                    bound = D->indent;
+                }
             }
+        } else
+        {
+            const QSourceBlockData* D = blockData( P );
+            level                     = _foldLevels[ n - 1 ] + ( D ? D->foldDelta : 0 );
+        }
+    }
 
-            //if len is zero, that means this wasn't an esc seq
-            //increment i so that we skip this backslash
-            if (len == 0) {
-                    setFormat(i, 1, _theme[CodeString]);
-                    ++i;
-                    continue;
+    for ( ; B.isValid() && n <= upTo; B = B.next(), ++n )
+    {
+        const QSourceBlockData* D = blockData( B );
+        if ( indentFolding )
+        {
+            if ( D && D->indent >= 0 )
+            {
+                while ( !indents.isEmpty() && indents.last() >= D->indent )
+                    indents.removeLast();
+                _foldLevels[ n ] = indents.size();
+                indents.append( D->indent );
+            } else
+            {
+                // blank lines stay on the level of the previous line
+                _foldLevels[ n ] = qMax( 0, int( indents.size() ) - 1 );
             }
+        } else
+        {
+            _foldLevels[ n ] = level;
+            if ( D )
+                level += D->foldDelta;
+        }
+    }
 
-            setFormat(i, len, _theme[CodeNumLiteral]);
-            i += len;
-            continue;
+    _foldValid = n;
+}
+
+int QSourceHighlighter::foldLevel( int blockNumber ) const
+{
+    if ( blockNumber < 0 || blockNumber >= document()->blockCount() )
+        return 0;
+
+    updateFoldLevels( blockNumber );
+    if ( usesIndentFolding() )
+        return _foldLevels[ blockNumber ];
+
+    const QSourceBlockData* D = blockData( document()->findBlockByNumber( blockNumber ) );
+    return qMax( 0, _foldLevels[ blockNumber ] + ( D ? D->foldMin : 0 ) );
+}
+
+bool QSourceHighlighter::isFoldStart( int blockNumber ) const
+{
+    const QTextBlock        B = document()->findBlockByNumber( blockNumber );
+    const QSourceBlockData* D = blockData( B );
+    if ( D == nullptr )
+        return false;
+
+    if ( !usesIndentFolding() )
+        return D->opensFold();
+
+    if ( D->indent < 0 )
+        return false;
+
+    // a region starts if the next non blank line is indented deeper
+    for ( QTextBlock N = B.next(); N.isValid(); N = N.next() )
+    {
+        const QSourceBlockData* ND = blockData( N );
+        if ( ND && ND->indent >= 0 )
+            return ND->indent > D->indent;
+    }
+    return false;
+}
+
+int QSourceHighlighter::foldEnd( int blockNumber ) const
+{
+    if ( !isFoldStart( blockNumber ) )
+        return -1;
+
+    const int count = document()->blockCount();
+    updateFoldLevels( count - 1 );
+
+    QTextBlock              B = document()->findBlockByNumber( blockNumber );
+    const QSourceBlockData* D = blockData( B );
+
+    if ( usesIndentFolding() )
+    {
+        const int level = _foldLevels[ blockNumber ];
+        int       last  = blockNumber;
+        int       n     = blockNumber + 1;
+        for ( B = B.next(); B.isValid(); B = B.next(), ++n )
+        {
+            const QSourceBlockData* ND = blockData( B );
+            if ( ND == nullptr || ND->indent < 0 )
+                continue;
+            if ( _foldLevels[ n ] <= level )
+                break;
+            last = n;
         }
-        setFormat(i, 1, _theme[CodeString]);
-        ++i;
+        return last;
     }
 
-    setCurrentBlockState( _language->id + ( ( !stringClosed ) ? 2 : 0 ) );
-    return i;
+    // the region ends in the block that drops below the level it opened
+    const int inside = _foldLevels[ blockNumber ] + D->foldDelta;
+    int       n      = blockNumber + 1;
+    for ( B = B.next(); B.isValid(); B = B.next(), ++n )
+    {
+        const QSourceBlockData* ND = blockData( B );
+        if ( _foldLevels[ n ] + ( ND ? ND->foldMin : 0 ) < inside )
+            return n;
+    }
+    return count - 1;
 }
 
 /**
@@ -472,11 +2644,11 @@ int QSourceHighlighter::highlightNumericLiterals(const QString &text, int i)
         {
             //css number
             case ':':
-                if ( currentBlockState() == CSSID )
+                if ( _blockState == CSSID )
                     isPreAllowed = true;
                 break;
             case '$':
-                if ( currentBlockState() == AsmID )
+                if ( _blockState == AsmID )
                     isPreAllowed = true;
                 break;
             case '[':
@@ -502,7 +2674,7 @@ int QSourceHighlighter::highlightNumericLiterals(const QString &text, int i)
     const int start = i;
 
     if ((i+1) >= text.length()) {
-        setFormat(i, 1, _theme[CodeNumLiteral]);
+        formatToken(i, 1, CodeNumLiteral);
         return ++i;
     }
 
@@ -545,7 +2717,7 @@ int QSourceHighlighter::highlightNumericLiterals(const QString &text, int i)
                 break;
             // for 100u, 1.0F
             case 'p':
-                if ( currentBlockState() == CSSID )
+                if ( _blockState == CSSID )
                     if ( i + 1 < text.length() && text.at( i + 1 ) == QChar( 'x' ) )
                     {
                         if ( i + 2 == text.length() || !text.at( i + 2 ).isLetterOrNumber() )
@@ -553,7 +2725,7 @@ int QSourceHighlighter::highlightNumericLiterals(const QString &text, int i)
                     }
                 break;
             case 'e':
-                if ( currentBlockState() == CSSID )
+                if ( _blockState == CSSID )
                     if ( i + 1 < text.length() && text.at( i + 1 ) == QChar( 'm' ) )
                     {
                         if ( i + 2 == text.length() || !text.at( i + 2 ).isLetterOrNumber() )
@@ -576,334 +2748,514 @@ int QSourceHighlighter::highlightNumericLiterals(const QString &text, int i)
     }
     if (isPostAllowed) {
         int end = i;
-        setFormat(start, end - start, _theme[CodeNumLiteral]);
+        formatToken(start, end - start, CodeNumLiteral);
     }
     //decrement so that the index is at the last number, not after it
     return --i;
 }
 
+// the next c at or after from, the scan asks for increasing positions so
+// a found one is reused until the scan passes it, and none stays none
+static int nextOf( QStringView text, QChar c, int from, int& cached )
+{
+    if ( cached == -2 || ( cached != -1 && cached < from ) )
+        cached = indexOf( text, c, from );
+    return cached;
+}
+
 /**
- * @brief The YAML highlighter
- * @param text
- * @details This function post processes a line after the main syntax
- * highlighter has run for additional highlighting. It does these things
- *
- * If the current line is a comment, skip it
- *
- * Highlight all the words that have a colon after them as 'keyword' except:
- * If the word is a string, skip it.
- * If the colon is in between a path, skip it (C:\)
- *
- * Once the colon is found, the function will skip every character except 'h'
- *
- * If an h letter is found, check the next 4/5 letters for http/https and
- * highlight them as a link (underlined)
+ * @brief The hooks of the languages with rules of their own
  */
-void QSourceHighlighter::ymlHighlighter(TextValue text)
+const QSourceHighlighter::LanguageHooks* QSourceHighlighter::languageHooks( const QString& language )
 {
-    if (text.isEmpty())
-        return;
-    const auto textLen = text.length();
-    bool colonNotFound = false;
-
-    //if this is a comment don't do anything and just return
-    if ( text.trimmed().at( 0 ) == QChar( '#' ) )
-        return;
-
-    for (int i = 0; i < textLen; ++i) {
-        if (!text.at(i).isLetter()) continue;
-
-        if ( colonNotFound && text.at( i ) != QChar( 'h' ) )
-            continue;
+    static const LanguageHooks css{ &QSourceHighlighter::cssWord, &QSourceHighlighter::cssChar };
+    static const LanguageHooks yaml{ &QSourceHighlighter::yamlWord, &QSourceHighlighter::yamlChar };
+    static const LanguageHooks make{ nullptr, &QSourceHighlighter::makeChar };
+    static const LanguageHooks assembly{ &QSourceHighlighter::asmWord, &QSourceHighlighter::asmChar };
+
+    if ( language == QLatin1String( "css" ) )
+        return &css;
+    if ( language == QLatin1String( "yaml" ) )
+        return &yaml;
+    if ( language == QLatin1String( "make" ) )
+        return &make;
+    if ( language == QLatin1String( "asm" ) )
+        return &assembly;
+    return nullptr;
+}
 
-        //we found a string lighteral, skip it
-        if ( i != 0 && ( text.at( i - 1 ) == QChar( '"' ) || text.at( i - 1 ) == QChar( '\'' ) ) )
-        {
-            const int next = text.indexOf(text.at(i-1), i);
-            if (next == -1) break;
-            i = next;
-            continue;
-        }
+/**
+ * @brief YAML links, and the start of the key, its first word in code
+ */
+int QSourceHighlighter::yamlWord( TextValue text, int start, int end )
+{
+    if ( _hookState.keyStart == -1 )
+        _hookState.keyStart = start;
+
+    if ( !text.mid( start ).startsWith( QLatin1String( "http" ) ) )
+        return end;
+    int space = indexOf( text, QChar( ' ' ), start );
+    if ( space == -1 )
+        space = text.length();
+    formatToken( start, space - start, CodeString, Underline );
+    return space;
+}
 
-        const int colon = text.indexOf( QChar( ':' ), i );
+/**
+ * @brief YAML keys, up to the first colon in code, e.g. "key" in "- key: value"
+ * @details strings and comments never get here, so a quoted key or a
+ * colon in a comment is left alone
+ */
+int QSourceHighlighter::yamlChar( TextValue text, int i )
+{
+    if ( text[ i ] != QChar( ':' ) || _hookState.done || _hookState.keyStart == -1 )
+        return i;
 
-        //if colon isn't found, we set this true
-        if (colon == -1) colonNotFound = true;
+    _hookState.done = true;
+    formatToken( _hookState.keyStart, i - _hookState.keyStart, CodeKeyWord );
+    if ( i + 1 == text.length() || text[ i + 1 ].isSpace() )
+        addSymbol( text, _hookState.keyStart, i, SymbolKey );
+    return i;
+}
 
-        if (!colonNotFound) {
-            //if the line ends here, format and return
-            if (colon + 1 == textLen) {
-                    setFormat(i, colon - i, _theme[CodeKeyWord]);
-                    return;
-            } else {
-                    //colon is found, check if it isn't some path or something else
-                    if (!(text.at(colon + 1) == QChar('\\') && text.at(colon + 1) == QChar('/'))) {
-                        setFormat(i, colon - i, _theme[CodeKeyWord]);
-                    }
-            }
-        }
+/**
+ * @brief CSS selectors, e.g. ".name" and "#name"
+ */
+int QSourceHighlighter::cssChar( TextValue text, int i )
+{
+    const int   textLen = text.length();
+    const QChar c       = text[ i ];
+    if ( c == QChar( ':' ) )
+    {
+        _hookState.colon = true;
+        return i;
+    }
+    if ( ( c != QChar( '.' ) && c != QChar( '#' ) ) || i + 1 >= textLen || text[ i + 1 ].isSpace() || text[ i + 1 ].isNumber() )
+        return i;
 
-        //underlined links
-        if ( text.at( i ) == QChar( 'h' ) )
-        {
-            if (text.MIDREF(i, 5) == QStringLiteral("https")
-                || text.MIDREF(i, 4) == QStringLiteral("http")) {
-                int space = text.indexOf(QChar(' '), i);
-                if (space == -1) space = textLen;
-                QTextCharFormat f = _theme[CodeString];
-                f.setUnderlineStyle(QTextCharFormat::SingleUnderline);
-                setFormat(i, space - i, f);
-                i = space;
-            }
-        }
+    // "color: #fff" is a value, not a selector
+    const bool selector = !_hookState.colon;
+    int        end      = i + 1;
+    while ( end < textLen && !text[ end ].isSpace() && text[ end ] != QChar( '{' ) )
+    {
+        _hookState.colon = _hookState.colon || text[ end ] == QChar( ':' );
+        ++end;
     }
+    formatToken( i, end - i, CodeKeyWord );
+    if ( selector )
+        addSymbol( text, i, end, SymbolSelector );
+    return end;
 }
 
-void QSourceHighlighter::cssHighlighter(TextValue text)
+/**
+ * @brief CSS colors, the value of "color: #fff;" gets a swatch of the color
+ */
+int QSourceHighlighter::cssWord( TextValue text, int start, int end )
 {
-    if (text.isEmpty()) return;
-    const auto textLen = text.length();
-    for (int i = 0; i<textLen; ++i) {
-        if ( text[ i ] == QChar( '.' ) || text[ i ] == QChar( '#' ) )
-        {
-            if (i+1 >= textLen) return;
-            if (text[i + 1].isSpace() || text[i+1].isNumber()) continue;
-            int space = text.indexOf( QChar( ' ' ), i );
-            if (space < 0) {
-                space = text.indexOf('{');
-                if (space < 0) {
-                    space = textLen;
-                }
-            }
-            setFormat(i, space - i, _theme[CodeKeyWord]);
-            i = space;
-        } else if ( text[ i ] == QChar( 'c' ) )
-        {
-            if (text.mid(i, 5) == QStringLiteral("color")) {
-                i += 5;
-                int colon = text.indexOf( QChar( ':' ), i );
-                if (colon < 0) continue;
-                i = colon;
-                i++;
-                while(i < textLen) {
-                    if (!text[i].isSpace()) break;
-                    i++;
-                }
-                int semicolon = text.indexOf( QChar( ';' ) );
-                if (semicolon < 0)
-                    semicolon = textLen;
-                TextBuffer color = text.mid(i, semicolon - i);
-                QTextCharFormat f = _theme[CodeBlock];
-                QColor c(color);
-                if ( color.startsWith( QStringLiteral( "rgb" ) ) )
-                {
-                    int t    = text.indexOf( QChar( '(' ), i );
-                    int rPos = text.indexOf( QChar( ',' ), t );
-                    int gPos = text.indexOf( QChar( ',' ), rPos + 1 );
-                    int bPos = text.indexOf( QChar( ')' ), gPos );
-                    if (rPos > -1 && gPos > -1 && bPos > -1) {
-                            TextRef r = text.MIDREF(t + 1, rPos - (t + 1));
-                            TextRef g = text.MIDREF(rPos + 1, gPos - (rPos + 1));
-                            TextRef b = text.MIDREF(gPos + 1, bPos - (gPos + 1));
-                            c.setRgb(r.toInt(), g.toInt(), b.toInt());
-                    } else {
-                            c = _theme[CodeBlock].background().color();
-                    }
-                }
+    const int textLen = text.length();
+    if ( !text.mid( start ).startsWith( QLatin1String( "color" ) ) || ( start + 5 < textLen && text[ start + 5 ].isLetter() ) )
+        return end;
+
+    const int colon = nextOf( text, QChar( ':' ), start + 5, _hookState.nextColon );
+    if ( colon == -1 )
+        return end;
+    _hookState.colon = true;
+    int value        = colon + 1;
+    while ( value < textLen && text[ value ].isSpace() )
+        ++value;
+    int semicolon = nextOf( text, QChar( ';' ), value, _hookState.nextSemicolon );
+    if ( semicolon == -1 )
+        semicolon = textLen;
+
+    const QColor c = cssColor( text.mid( value, semicolon - value ) );
+    if ( !c.isValid() )
+        return end;
+    formatToken( value, semicolon - value, CodeBlock, ColorSwatch, c.rgba() );
+    return semicolon;
+}
 
-                if (!c.isValid()) {
-                    continue;
-                }
+/**
+ * @brief Parse a css color value, e.g. "#fff", "red" or "rgb(1, 2, 3)"
+ * @param color the value, up to the semicolon
+ * @returns the color, invalid if it isn't one
+ * @details Results are cached per theme, colors repeat a lot in style sheets
+ */
+QColor QSourceHighlighter::cssColor(TextValue color)
+{
+    // looked up by the view, the value is only copied the first time
+    const uint hash = uint( qHash( color ) );
+    auto       it   = _cssColors.constFind( hash );
+    if ( it != _cssColors.constEnd() && QStringView( it->first ) == color )
+        return it->second;
+
+    const QString key = color.toString();
+    QColor        c( key );
+    if ( color.startsWith( QStringLiteral( "rgb" ) ) )
+    {
+        int t    = indexOf( color, QChar( '(' ) );
+        int rPos = indexOf( color, QChar( ',' ), t );
+        int gPos = indexOf( color, QChar( ',' ), rPos + 1 );
+        int bPos = indexOf( color, QChar( ')' ), gPos );
+        if (rPos > -1 && gPos > -1 && bPos > -1) {
+                TextRef r = color.mid( t + 1, rPos - ( t + 1 ) ).trimmed();
+                TextRef g = color.mid( rPos + 1, gPos - ( rPos + 1 ) ).trimmed();
+                TextRef b = color.mid( gPos + 1, bPos - ( gPos + 1 ) ).trimmed();
+                const QLocale C = QLocale::c();
+                c.setRgb( C.toInt( r ), C.toInt( g ), C.toInt( b ) );
+        } else {
+                c = _theme[CodeBlock].background().color();
+        }
+    }
 
-                int lightness{};
-                QColor foreground;
-                //really dark
-                if (c.lightness() <= 20) {
-                    foreground = Qt::white;
-                } else if (c.lightness() > 20 && c.lightness() <= 51){
-                    foreground = QColor( 12, 12, 12 );
-                } else if (c.lightness() > 51 && c.lightness() <= 78){
-                    foreground = QColor( 11, 11, 11 );
-                } else if (c.lightness() > 78 && c.lightness() <= 110){
-                    foreground = QColor( 10, 10, 10 );
-                } else if (c.lightness() > 127) {
-                    lightness = c.lightness() + 100;
-                    foreground = c.darker(lightness);
-                }
-                else {
-                    lightness = c.lightness() + 100;
-                    foreground = c.lighter(lightness);
-                }
+    _cssColors.insert( hash, qMakePair( key, c ) );
+    return c;
+}
 
-                f.setBackground(c);
-                f.setForeground(foreground);
-                setFormat(i, semicolon - i, QTextCharFormat()); //clear prev format
-                setFormat(i, semicolon - i, f);
-                i = semicolon;
-            }
+/**
+ * @brief A theme format with modifiers applied
+ * @param token the theme format to start from
+ * @param modifiers FormatModifier flags
+ * @param color the swatch color for ColorSwatch
+ * @returns the shared format, valid until the next call
+ * @details Every distinct format is created once per theme and then reused,
+ * instead of copying and modifying the theme format on every line.
+ */
+const QTextCharFormat &QSourceHighlighter::derivedFormat(Token token, int modifiers, QRgb color)
+{
+    const quint64 key = quint64(token) | (quint64(modifiers) << 8) | (quint64(color) << 16);
+    auto it = _derivedFormats.constFind(key);
+    if (it != _derivedFormats.constEnd())
+        return *it;
+
+    QTextCharFormat f = _theme[token];
+    if (modifiers & Underline) {
+        f.setUnderlineStyle(QTextCharFormat::SingleUnderline);
+    }
+    if (modifiers & ColorSwatch) {
+        const QColor c = QColor::fromRgba(color);
+        int lightness{};
+        QColor foreground;
+        //really dark
+        if (c.lightness() <= 20) {
+            foreground = Qt::white;
+        } else if (c.lightness() > 20 && c.lightness() <= 51){
+            foreground = QColor( 12, 12, 12 );
+        } else if (c.lightness() > 51 && c.lightness() <= 78){
+            foreground = QColor( 11, 11, 11 );
+        } else if (c.lightness() > 78 && c.lightness() <= 110){
+            foreground = QColor( 10, 10, 10 );
+        } else if (c.lightness() > 127) {
+            lightness = c.lightness() + 100;
+            foreground = c.darker(lightness);
         }
+        else {
+            lightness = c.lightness() + 100;
+            foreground = c.lighter(lightness);
+        }
+        f.setBackground(c);
+        f.setForeground(foreground);
     }
+
+    return *_derivedFormats.insert(key, f);
 }
 
-void QSourceHighlighter::xmlHighlighter(TextValue text)
+/**
+ * @brief Lex a line of xml or html in one pass
+ * @param text
+ * @param contextsOnly only format comments, values and CDATA, for huge lines
+ * @details The block state tells which construct the line starts in, see
+ * XmlMode, so tags, values, comments and CDATA sections can span lines.
+ * Every char is formatted once, the gaps between tokens as CodeBlock, and
+ * the end of each construct is searched once from where it starts.
+ */
+void QSourceHighlighter::xmlHighlighter( TextValue text, bool contextsOnly )
 {
-    if (text.isEmpty()) return;
-    const auto textLen = text.length();
-
-    setFormat(0, textLen, _theme[CodeBlock]);
+    const int textLen = text.length();
+    int       mode    = _blockState - _language->id;
+    int       i       = 0;
+    int       done    = 0;     // formatted up to here
+    int       from    = 0;     // where to look for the end of the construct, past its start
+    bool      value   = false; // after '=' in a tag, for unquoted html values
+    bool      closed  = false;
+
+    auto put = [ this, &done, contextsOnly ]( int start, int end, Token token ) {
+        if ( end <= start || ( contextsOnly && token != CodeComment && token != CodeString ) )
+            return;
+        if ( done < start )
+            formatToken( done, start - done, CodeBlock );
+        formatToken( start, end - start, token );
+        done = end;
+    };
+    // the end of a construct closed by terminator, or of the line
+    auto until = [ &text, textLen, &closed ]( QLatin1String terminator, int start ) {
+        const int end = indexOf( text, terminator, start );
+        closed        = end != -1;
+        return closed ? end + int( terminator.size() ) : textLen;
+    };
 
-    for (int i = 0; i < textLen; ++i) {
-        if ( text[ i ] == QChar( '<' ) && text[ i + 1 ] != QChar( '!' ) )
+    while ( i < textLen )
+    {
+        switch ( mode )
         {
-
-            const int found = text.indexOf( QChar( '>' ), i );
-            if (found > 0) {
-                ++i;
-                if ( text[ i ] == QChar( '/' ) )
-                    ++i;
-                setFormat(i, found - i, _theme[CodeKeyWord]);
+            case XmlComment:
+            {
+                const int end = until( QLatin1String( "-->" ), qMax( i, from ) );
+                put( i, end, CodeComment );
+                markContext( i, end, CodeComment );
+                i = end;
+                if ( closed )
+                    mode = XmlText;
+                break;
             }
-        }
-
-        if ( text[ i ] == QChar( '=' ) )
-        {
-            int lastSpace = text.lastIndexOf( QChar( ' ' ), i );
-            if ( lastSpace == i - 1 )
-                lastSpace = text.lastIndexOf( QChar( ' ' ), i - 2 );
-            if (lastSpace > 0) {
-                setFormat(lastSpace, i - lastSpace, _theme[CodeBuiltIn]);
+            case XmlCData:
+            {
+                const int end     = until( QLatin1String( "]]>" ), i );
+                const int content = closed ? end - 3 : end;
+                put( i, content, CodeString );
+                markContext( i, content, CodeString );
+                put( content, end, CodeKeyWord );
+                i = end;
+                if ( closed )
+                    mode = XmlText;
+                break;
             }
-        }
-
-        if ( text[ i ] == QChar( '\"' ) )
-        {
-            const int pos = i;
-            int cnt = 1;
-            ++i;
-            //bound check
-            if ( (i+1) >= textLen) return;
-            while (i < textLen) {
-                if ( text[ i ] == QChar( '\"' ) )
+            case XmlInstruction:
+            {
+                const int end = until( QLatin1String( "?>" ), qMax( i, from ) );
+                put( i, end, CodeOther );
+                i = end;
+                if ( closed )
+                    mode = XmlText;
+                break;
+            }
+            case XmlDeclaration:
+            {
+                // up to '>', or to the '[' of a DOCTYPE internal subset
+                // whose declarations are lexed as text
+                int j = i;
+                while ( j < textLen && text[ j ] != QChar( '>' ) && text[ j ] != QChar( '[' ) )
+                {
+                    if ( text[ j ] != QChar( '"' ) && text[ j ] != QChar( '\'' ) )
+                    {
+                        ++j;
+                        continue;
+                    }
+                    put( i, j, CodeType );
+                    int end = indexOf( text, text[ j ], j + 1 );
+                    end     = ( end == -1 ) ? textLen : end + 1;
+                    put( j, end, CodeString );
+                    markContext( j, end, CodeString );
+                    i = j = end;
+                }
+                if ( j < textLen )
+                {
+                    ++j;
+                    mode = XmlText;
+                }
+                put( i, j, CodeType );
+                i = j;
+                break;
+            }
+            case XmlValue:
+            case XmlSingleValue:
+            {
+                const QChar quote = ( mode == XmlValue ) ? QChar( '"' ) : QChar( '\'' );
+                int         end   = indexOf( text, quote, qMax( i, from ) );
+                closed            = end != -1;
+                end               = closed ? end + 1 : textLen;
+                put( i, end, CodeString );
+                markContext( i, end, CodeString );
+                i = end;
+                if ( closed )
+                    mode = XmlTag;
+                break;
+            }
+            case XmlTag:
+            {
+                const QChar c = text[ i ];
+                if ( c == QChar( '>' ) )
+                {
+                    ++i;
+                    mode = XmlText;
+                } else if ( c == QChar( '/' ) && i + 1 < textLen && text[ i + 1 ] == QChar( '>' ) )
                 {
-                    ++cnt;
+                    i += 2;
+                    mode = XmlText;
+                } else if ( c == QChar( '<' ) )
+                {
+                    // a tag that isn't closed, go on with the next one
+                    mode = XmlText;
+                } else if ( c == QChar( '"' ) || c == QChar( '\'' ) )
+                {
+                    mode  = ( c == QChar( '"' ) ) ? XmlValue : XmlSingleValue;
+                    from  = i + 1;
+                    value = false;
+                } else if ( c == QChar( '=' ) || c.isSpace() )
+                {
+                    value = value || c == QChar( '=' );
                     ++i;
+                } else
+                {
+                    int end = i + 1;
+                    while ( end < textLen && !endsXmlName( text[ end ], value ) )
+                        ++end;
+                    put( i, end, value ? CodeString : CodeBuiltIn );
+                    if ( value )
+                        markContext( i, end, CodeString );
+                    value = false;
+                    i     = end;
+                }
+                break;
+            }
+            default:
+            {
+                const QChar c = text[ i ];
+                if ( c == QChar( '&' ) )
+                {
+                    // entity and character references
+                    int end = i + 1;
+                    while ( end < textLen && end - i < 32 && ( text[ end ].isLetterOrNumber() || text[ end ] == QChar( '#' ) ) )
+                        ++end;
+                    if ( end > i + 1 && end < textLen && text[ end ] == QChar( ';' ) )
+                    {
+                        put( i, end + 1, CodeNumLiteral );
+                        i = end + 1;
+                    } else
+                        ++i;
                     break;
                 }
-                ++i; ++cnt;
-                //bound check
-                if ( (i+1) >= textLen) {
-                    ++cnt;
+                if ( c != QChar( '<' ) )
+                {
+                    ++i;
+                    while ( i < textLen && text[ i ] != QChar( '<' ) && text[ i ] != QChar( '&' ) )
+                        ++i;
                     break;
                 }
+
+                const TextBuffer rest = text.mid( i );
+                if ( rest.startsWith( QLatin1String( "<!--" ) ) )
+                {
+                    mode = XmlComment;
+                    from = i + 4;
+                } else if ( rest.startsWith( QLatin1String( "<![CDATA[" ) ) )
+                {
+                    put( i, i + 9, CodeKeyWord );
+                    i += 9;
+                    mode = XmlCData;
+                } else if ( rest.startsWith( QLatin1String( "<!" ) ) )
+                {
+                    mode = XmlDeclaration;
+                } else if ( rest.startsWith( QLatin1String( "<?" ) ) )
+                {
+                    mode = XmlInstruction;
+                    from = i + 2;
+                } else
+                {
+                    int start = i + 1;
+                    if ( start < textLen && text[ start ] == QChar( '/' ) )
+                        ++start;
+                    // "a < b" in html text isn't a tag
+                    if ( start == textLen || !( text[ start ].isLetter() || text[ start ] == QChar( '_' ) || text[ start ] == QChar( ':' ) ) )
+                    {
+                        ++i;
+                        break;
+                    }
+                    int end = start + 1;
+                    while ( end < textLen && !endsXmlName( text[ end ], false ) )
+                        ++end;
+                    put( start, end, CodeKeyWord );
+                    i     = end;
+                    mode  = XmlTag;
+                    value = false;
+                }
+                break;
             }
-            setFormat(pos, cnt, _theme[CodeString]);
         }
     }
+
+    if ( done < textLen )
+        formatToken( done, textLen - done, CodeBlock );
+    _blockState = _language->id + mode;
 }
 
-void QSourceHighlighter::makeHighlighter(TextValue text)
+/**
+ * @brief Make targets, the line up to its first colon in code
+ */
+int QSourceHighlighter::makeChar( TextValue text, int i )
 {
-    int colonPos = text.indexOf( QChar( ':' ) );
-    if (colonPos == -1)
-        return;
-    setFormat(0, colonPos, _theme[Token::CodeBuiltIn]);
+    if ( text[ i ] != QChar( ':' ) || _hookState.done )
+        return i;
+
+    _hookState.done = true;
+    formatToken( 0, i, CodeBuiltIn );
+    // recipes start with a tab and "VAR := value" is an assignment
+    if ( i > 0 && text[ 0 ] != QChar( '\t' ) && ( i + 1 == text.length() || text[ i + 1 ] != QChar( '=' ) ) )
+        addSymbol( text, 0, i, SymbolTarget );
+    return i;
 }
 
 /**
- * @brief highlight inline labels such as 'func()' in "call func()"
- * @param text
+ * @brief asm jump targets, e.g. 'func()' in "call func()", underlined
+ * @details only the first word of a line is an instruction
  */
-void QSourceHighlighter::highlightInlineAsmLabels(TextValue text)
+int QSourceHighlighter::asmWord( TextValue text, int start, int end )
 {
-#define Q(s) QStringLiteral(s)
-    static const QString jumps[27] = {
-        //0 - 19
+#define Q(s) QLatin1String(s)
+    static const QLatin1String jumps[] = {
         Q("jmp"), Q("je"), Q("jne"), Q("jz"), Q("jnz"), Q("ja"), Q("jb"), Q("jg"), Q("jge"), Q("jae"), Q("jl"), Q("jle"),
         Q("jbe"), Q("jo"), Q("jno"), Q("js"), Q("jns"), Q("jcxz"), Q("jecxz"), Q("jrcxz"),
-        //20 - 24
         Q("loop"), Q("loope"), Q("loopne"), Q("loopz"), Q("loopnz"),
-        //25 - 26
         Q("call"), Q("callq")
     };
 #undef Q
 
-    auto format = _theme[Token::CodeBuiltIn];
-    format.setFontUnderline(true);
-
-    TextBuffer trimmed = text.trimmed();
-    int start = -1;
-    int end = -1;
-    QChar         c;
-    if (!trimmed.isEmpty())
-        c = trimmed.at( 0 );
-    if (c == 'j') {
-        start = 0; end = 20;
-    } else if (c == 'c') {
-        start = 25; end = 27;
-    } else if (c == 'l') {
-        start = 20; end = 25;
-    } else {
-        return;
-    }
-
-    auto skipSpaces = [&text](int& j){
-        while (text.at(j).isSpace()) j++;
-        return j;
-    };
-
-    for (int i = start; i < end; ++i) {
-        if (trimmed.startsWith(jumps[i])) {
-            int j = 0;
-            skipSpaces(j);
-            j = j + jumps[i].length() + 1;
-            skipSpaces(j);
-            int len = text.length() - j;
-            setFormat(j, len, format);
-        }
-    }
+    if ( _hookState.done )
+        return end;
+    _hookState.done = true;
+
+    const int textLen = text.length();
+    int       wordEnd = start;
+    while ( wordEnd < textLen && text[ wordEnd ].isLetter() )
+        ++wordEnd;
+    const TextBuffer word = text.mid( start, wordEnd - start );
+    if ( std::none_of( std::begin( jumps ), std::end( jumps ), [ &word ]( QLatin1String J ) { return word == J; } ) )
+        return end;
+
+    int target = wordEnd;
+    while ( target < textLen && text[ target ].isSpace() )
+        ++target;
+    // up to a trailing comment, which the scan goes on with
+    const QChar comment = _language->definition->comment;
+    int         last    = target;
+    while ( last < textLen && text[ last ] != comment )
+        ++last;
+    formatToken( target, last - target, CodeBuiltIn, Underline );
+    return last;
 }
 
-void QSourceHighlighter::asmHighlighter(TextValue text)
+/**
+ * @brief asm labels, e.g. "L1:" or "LFB1:  # local func begin"
+ * @details but not "mov %eax, Count::count(%rip)", the colon of a label
+ * is only followed by blanks or a comment
+ */
+int QSourceHighlighter::asmChar( TextValue text, int i )
 {
-    highlightInlineAsmLabels(text);
-    //label highlighting
-    //examples:
-    //L1:
-    //LFB1:           # local func begin
-    //
-    //following e.gs are not a label
-    //mov %eax, Count::count(%rip)
-    //.string ": #%s"
-
-    //look for the last occurence of a colon
-    int colonPos = text.lastIndexOf( QChar( ':' ) );
-    if (colonPos == -1)
-        return;
-    //check if this colon is in a comment maybe?
-    bool isComment = text.lastIndexOf('#', colonPos) != -1;
-    if (isComment) {
-        int commentPos = text.lastIndexOf('#', colonPos);
-        colonPos = text.lastIndexOf(':', commentPos);
-    }
-
-    auto format = _theme[Token::CodeBuiltIn];
-    format.setFontUnderline(true);
-
-    if (colonPos >= text.length() - 1) {
-        setFormat(0, colonPos, format);
-    }
+    // ".string" and the like aren't instructions
+    _hookState.done = true;
+    if ( text[ i ] != QChar( ':' ) )
+        return i;
 
-    int i = 0;
-    bool isLabel = true;
-    for (i = colonPos + 1; i < text.length(); ++i) {
-        if (!text.at(i).isSpace()) {
-            isLabel = false;
-            break;
-        }
+    const int   textLen = text.length();
+    const QChar comment = _language->definition->comment;
+    int         next    = i + 1;
+    while ( next < textLen && text[ next ].isSpace() )
+        ++next;
+    if ( next == textLen || text[ next ] == comment )
+    {
+        formatToken( 0, i, CodeBuiltIn, Underline );
+        addSymbol( text, 0, i, SymbolLabel );
     }
-
-    if ( !isLabel && i < text.length() && text.at( i ) == QChar( '#' ) )
-        setFormat(0, colonPos, format);
+    return i;
 }
 
 #if Q_VERSION_MAJOR >= 6
@@ -913,7 +3265,11 @@ void QSourceHighlighter::applyTheme(const QString &themeName)
 #endif
 {
     _theme = getTheme(themeName);
-    rehighlight();
+    for (int t = CodeBlock; t < TokenCount; ++t)
+        _tokenFormats[t] = _theme.value(Token(t));
+    _derivedFormats.clear();
+    _cssColors.clear();
+    requestRehighlight();
 }
 
 #if Q_VERSION_MAJOR >= 6
@@ -23,16 +23,32 @@
 
 #pragma once
 
+#include "qsourceblockdata.h"
+
+#include <QColor>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHash>
 #include <QMap>
+#include <QSharedPointer>
 #include <QSyntaxHighlighter>
+#include <QTextBlock>
+#include <QTextCharFormat>
+#include <QTimer>
+#include <QVector>
 #include <QtCore/QtGlobal>
+#include <atomic>
 #if Q_VERSION_MAJOR >= 6
 #include <QStringView>
 #endif
 
+class AnnotationMatcher;
 struct ALanguage;
 class LanguageDB;
 class QSettings;
+class QSourceHighlightCache;
+struct QSourceHighlightCacheEntry;
+class QSourceHighlightScheduler;
 
 #if defined(MYQSOURCEHIGHLIGHTER_LIBRARY)
 #define QSOURCEHIGHLIGHTER_EXPORT Q_DECL_EXPORT
@@ -44,6 +60,8 @@ class QSettings;
 
 class QSOURCEHIGHLIGHTER_EXPORT QSourceHighlighter : public QSyntaxHighlighter
 {
+    Q_OBJECT
+
 public:
     enum Token {
         CodeBlock,
@@ -54,9 +72,85 @@ public:
         CodeOther,
         CodeNumLiteral,
         CodeBuiltIn,
+        TokenCount // not a token
     };
     Q_ENUM(Token)
 
+    enum FormatModifier {
+        NoModifier = 0x0,
+        Underline = 0x1,
+        ColorSwatch = 0x2,
+    };
+
+    enum SymbolKind {
+        SymbolLabel,    // asm labels
+        SymbolTarget,   // make targets
+        SymbolKey,      // yaml keys
+        SymbolSelector, // css selectors
+    };
+    Q_ENUM(SymbolKind)
+
+    struct Symbol
+    {
+        int        position; // document position
+        int        length;
+        SymbolKind kind;
+        QString    name;
+    };
+
+    /**
+     * @brief a highlighted range, as produced by highlightLine()
+     * @details the format is the theme format of token with the
+     * FormatModifier flags in modifiers applied, color is the swatch color
+     */
+    struct Span
+    {
+        int     start; // document position
+        int     length;
+        Token   token;
+        quint8  modifiers;
+        QRgb    color;
+    };
+
+    enum AnnotationExtent {
+        AnnotationWord,   // the pattern as a whole word, e.g. TODO
+        AnnotationLink,   // the pattern up to the next space or quote, e.g. https://
+        AnnotationNumber, // the pattern followed by digits, e.g. #123
+    };
+
+    /**
+     * @brief a pattern highlighted in comments and strings, see setAnnotations()
+     */
+    struct Annotation
+    {
+        QString          pattern;
+        AnnotationExtent extent;
+        Token            token;
+        int              modifiers; // FormatModifier flags
+    };
+
+    /**
+     * @brief a token from a semantic analysis, see setSemanticTokens()
+     */
+    struct SemanticToken
+    {
+        int position; // document position
+        int length;
+        int type; // see setSemanticFormat()
+    };
+
+    /**
+     * @brief counters of edit batching, see setEditBatching()
+     */
+    struct BatchStatistics
+    {
+        qint64 requests = 0; // blocks the edits asked to lex
+        qint64 distinct = 0; // blocks among them, each counted once per flush
+        qint64 lexed    = 0; // blocks lexed when the edits settled, with the cascades
+        qint64 avoided  = 0; // requests - distinct, the lexing saved
+        int    flushes  = 0;
+    };
+
     class Theme : public QHash<Token, QTextCharFormat>
     {
     public:
@@ -71,10 +165,59 @@ public:
 
     explicit QSourceHighlighter(QTextDocument *doc);
     QSourceHighlighter(QTextDocument *doc, const QString &theme);
+    ~QSourceHighlighter() override;
 
     bool setCurrentLanguage(const QString &language);
     bool                      setCurrentLanguageByExtension( const QString& extension );
     Q_REQUIRED_RESULT QString currentLanguage();
+    /**
+     * @brief registers a language from a JSON definition file, which has the
+     * format of the files in languages/. Works with static language tables too.
+     */
+    static void addLanguage( const QString& language, const QString& definitionFile, const QStringList& extensions );
+    /**
+     * @brief name of the language for a file extension, empty if there is none
+     */
+    Q_REQUIRED_RESULT static QString languageForExtension( const QString& extension );
+    /**
+     * @brief name of the language for a file, by its suffix or, for files
+     * without one such as Makefile, by its name. Empty if there is none.
+     */
+    Q_REQUIRED_RESULT static QString languageForFile( const QString& fileName );
+    /**
+     * @brief loads languages on worker threads, e.g. at application startup
+     * @param languages the languages to load, all of them if empty
+     * @returns a future that finishes once all of them are loaded
+     * @details A highlighter switched to a language that is still loading
+     * doesn't block, it highlights the document once the language is ready.
+     */
+    static QFuture< void > warmUp( const QStringList& languages = QStringList() );
+    /**
+     * @brief heap memory used by the definition of language, 0 if it isn't loaded
+     * @details Languages sharing a definition, e.g. c and cpp, report the same memory.
+     */
+    Q_REQUIRED_RESULT static qint64 languageMemoryUsage( const QString& language );
+    /**
+     * @brief heap memory used by all the loaded definitions
+     */
+    Q_REQUIRED_RESULT static qint64 languageMemoryUsage();
+    /**
+     * @brief unloads the definitions no highlighter has used for msecs,
+     * e.g. from a timer. They are loaded again when they are needed.
+     * @returns the number of definitions unloaded
+     */
+    static int unloadUnusedLanguages( int msecs );
+    /**
+     * @brief the dialects of language, e.g. avx, x87 and simd for asm
+     * @details The words of a dialect are loaded when a word with its prefix
+     * is first missed as the first word of a line, or by loadLanguageDialect().
+     */
+    Q_REQUIRED_RESULT static QStringList languageDialects( const QString& language );
+    /**
+     * @brief loads a dialect ahead of use, e.g. once a detector found it in a file
+     * @returns false if language has no such dialect
+     */
+    static bool loadLanguageDialect( const QString& language, const QString& dialect );
 #if Q_VERSION_MAJOR >= 6
     void applyTheme(QStringView themeName);
     void addTheme(QStringView themeName, const Theme &theme);
@@ -85,11 +228,245 @@ public:
     Theme getTheme(const QString &themeName);
 #endif
 
+    /**
+     * @brief finds the bracket matching the one at position
+     * @param position document position of a bracket
+     * @returns the document position of the matching bracket, or -1 if there
+     * is none or if position is not a bracket in code (e.g. in a string)
+     * @details only the brackets recorded while highlighting are visited, and
+     * blocks that cannot contain the match are skipped using their depth summary
+     */
+    Q_REQUIRED_RESULT int matchingBracket( int position ) const;
+
+    /**
+     * @brief fold level of a block, i.e. the number of regions enclosing it
+     * @details regions come from braces, multi-line comments and region markers
+     * (#region, // region, #pragma region), or from the indentation in Python
+     * and YAML. Levels are computed lazily from the per block fold markers
+     * and only recomputed after the first block whose markers changed.
+     */
+    Q_REQUIRED_RESULT int  foldLevel( int blockNumber ) const;
+    Q_REQUIRED_RESULT bool isFoldStart( int blockNumber ) const;
+    /**
+     * @brief last block of the region starting at blockNumber, or -1
+     */
+    Q_REQUIRED_RESULT int foldEnd( int blockNumber ) const;
+
+    /**
+     * @brief the outline symbols found while highlighting
+     * @param firstBlock first block to collect from
+     * @param lastBlock last block to collect from, -1 for the end of the document
+     * @details Labels, make targets, yaml keys and css selectors are recorded
+     * per block by the highlighter, so this only walks the block list.
+     */
+    Q_REQUIRED_RESULT QVector< Symbol > symbols( int firstBlock = 0, int lastBlock = -1 ) const;
+
+    /**
+     * @brief keep an index of the identifiers in code, for occurrences()
+     * @details The identifiers are recorded while lexing, whether they are
+     * keywords or not, and the index is updated per lexed block. Enabling it
+     * highlights the document again to fill the index.
+     */
+    void                   setIdentifierIndexEnabled( bool enabled );
+    Q_REQUIRED_RESULT bool identifierIndexEnabled() const;
+    /**
+     * @brief the identifier at document position, or an empty string if
+     * position isn't in an identifier in code
+     */
+    Q_REQUIRED_RESULT QString identifierAt( int position ) const;
+    /**
+     * @brief the document positions of identifier in code, sorted, e.g. to
+     * highlight all of them
+     * @details Strings and comments are never searched, and only the blocks
+     * listed in the index under identifier are visited. Empty without an index.
+     */
+    Q_REQUIRED_RESULT QVector< int > occurrences( const QString& identifier ) const;
+
+    /**
+     * @brief collects the blocks changed by a burst of edits, e.g. a large
+     * paste or a scripted refactoring, and lexes them once when no edit came
+     * for settleMsecs or when flushEdits() is called
+     * @details Meanwhile the changed blocks keep their previous formats.
+     * Disabling it flushes the blocks collected so far.
+     */
+    void setEditBatching( bool enabled, int settleMsecs = 100 );
+    Q_REQUIRED_RESULT bool editBatching() const;
+    void flushEdits();
+    Q_REQUIRED_RESULT BatchStatistics batchStatistics() const;
+
+    /**
+     * @brief lex changed blocks on a worker thread instead of in the edit
+     * @details An edit only marks its blocks, which keep their formats
+     * meanwhile. The text of the marked blocks and of the blocks after them
+     * is copied and lexed by a highlighter without a document on a worker,
+     * and the spans are set on the blocks back on the GUI thread, without
+     * lexing them again. Results for an older revision of the document are
+     * dropped and the blocks lexed again. Disabling it lexes the marked
+     * blocks right away.
+     */
+    void                   setBackgroundLexing( bool enabled );
+    Q_REQUIRED_RESULT bool backgroundLexing() const;
+
+    /**
+     * @brief follow mode for growing files such as logs
+     * @param maxBlocks the oldest blocks are evicted beyond this count, 0 keeps all
+     * @details Data is then added with appendChunk(), which only lexes the new
+     * lines. The undo stack is disabled while following.
+     */
+    void setFollowMode( bool enabled, int maxBlocks = 0 );
+    Q_REQUIRED_RESULT bool followMode() const;
+    void appendChunk( const QByteArray& chunk );
+    void flushFollow();
+
+    /**
+     * @brief lexes one line without a document, e.g. on a worker thread
+     * @param text the line, without the line break
+     * @param state the state the line starts in, -1 for the start of a file
+     * @param spans receives the spans of the line, in the order they were
+     * formatted, later spans override earlier ones
+     * @param offset added to the span positions, usually the line position
+     * @returns the state the next line starts in
+     * @details Works on a highlighter created without a document. Each
+     * highlighter must only be used by one thread at a time.
+     */
+    int highlightLine( const QString& text, int state, QVector< Span >& spans, int offset = 0 );
+    /**
+     * @brief the state a file of the current language starts in, see highlightLine()
+     */
+    Q_REQUIRED_RESULT int initialState() const;
+
+    /**
+     * @brief limits the cost of very long lines, e.g. minified code or dumps
+     * @param segmentLength lines longer than this are lexed with a checkpoint
+     * every segmentLength chars, and an edit lexes again from the last
+     * checkpoint before it. The language specific passes (css colors, yaml
+     * keys, make targets, asm labels) are skipped for them. 0 disables it.
+     * @param plainLimit only strings and comments are highlighted in lines
+     * longer than this, 0 disables it
+     */
+    void setLongLineLimits( int segmentLength, int plainLimit );
+    Q_REQUIRED_RESULT int longLineSegmentLength() const;
+    Q_REQUIRED_RESULT int longLinePlainLimit() const;
+
+    /**
+     * @brief the patterns highlighted in comments and strings
+     * @details They are found in a single pass over the comments and strings
+     * of a block, after lexing it, whatever the number of patterns. The
+     * default ones are TODO, FIXME and XXX markers, http and https links and
+     * #123 issue references. Lines lexed in segments aren't annotated.
+     */
+    void setAnnotations( const QVector< Annotation >& annotations );
+    Q_REQUIRED_RESULT QVector< Annotation > annotations() const;
+    Q_REQUIRED_RESULT static QVector< Annotation > defaultAnnotations();
+
+    /**
+     * @brief the format of a semantic token type, merged over the lexical format
+     * @details e.g. a foreground for functions or a gray one for unused variables
+     */
+    void setSemanticFormat( int type, const QTextCharFormat& format );
+    /**
+     * @brief replaces the semantic tokens from position from to to
+     * @details Only the blocks of the range are updated, and a block that was
+     * lexed with tokens before gets its formats from the lexical formats
+     * recorded then, without lexing it again. The tokens of a block are
+     * dropped when its text changes, until they are set again.
+     */
+    void setSemanticTokens( int from, int to, const QVector< SemanticToken >& tokens );
+    void clearSemanticTokens();
+    /**
+     * @brief the semantic tokens overlapping from to to, e.g. for a tooltip
+     */
+    Q_REQUIRED_RESULT QVector< SemanticToken > semanticTokens( int from, int to ) const;
+    /**
+     * @brief the setSemanticTokens() calls until endSemanticUpdate() are
+     * applied together, each block once
+     */
+    void beginSemanticUpdate();
+    void endSemanticUpdate();
+
+    /**
+     * @brief cache for the highlighting of the documents set with
+     * setPlainText(), nullptr to stop using it
+     */
+    void setCache( QSourceHighlightCache* cache );
+    /**
+     * @brief replaces the text of the document, like QTextDocument::setPlainText()
+     * @details With a cache the stored highlighting of text is used instead
+     * of lexing it, or the document is lexed and stored for the next time.
+     * Brackets and folds are still indexed, which is cheap.
+     */
+    void setPlainText( const QString& text );
+    /**
+     * @brief replaces the text of the document with highlighting computed
+     * elsewhere, e.g. by highlightText() or a QSourceHighlightClient
+     * @details The blocks beyond the lines of highlighting are lexed.
+     */
+    void setPlainText( const QString& text, const QSourceHighlightCacheEntry& highlighting );
+    /**
+     * @brief lexes text without a document, into the form setPlainText()
+     * stores in a cache
+     * @details Lines end at "\n", "\r\n" or "\r" and the positions are
+     * those of a document with that text. Works on a highlighter created
+     * without a document.
+     */
+    void highlightText( const QString& text, QSourceHighlightCacheEntry& highlighting );
+    /**
+     * @brief the cache key of text in the current language
+     * @see QSourceHighlightCache::key()
+     */
+    Q_REQUIRED_RESULT QByteArray cacheKey( const QString& text ) const;
+
+signals:
+    /**
+     * @brief emitted once after highlighting when the fold levels of
+     * firstBlock and the blocks after it may have changed
+     */
+    void foldingChanged( int firstBlock );
+    /**
+     * @brief emitted once after highlighting when the symbols of firstBlock
+     * to lastBlock changed, lastBlock is -1 if the blocks after firstBlock moved
+     */
+    void symbolsChanged( int firstBlock, int lastBlock );
+
 protected:
     void highlightBlock(const QString &text) override;
 
 private:
-    void highlightSyntax(const QString &text);
+    friend class QSourceHighlightScheduler;
+
+    void useLanguage( ALanguage* L );
+    void requestRehighlight();
+    Q_REQUIRED_RESULT bool deferBlock();
+    void endBurst();
+    int  lexPending( qint64 budget, int firstVisible, int lastVisible );
+    Q_REQUIRED_RESULT int blockStartState( const QTextBlock& block ) const;
+    void scheduleBackgroundJob();
+    void startBackgroundJob();
+    void applyBackgroundJob();
+    void replayBackgroundBlock( const QString& text );
+    void appendLines( const QString& lines );
+    void lexBlock( const QString& text );
+    void recordCachedBlock();
+    void replayCachedBlock( const QString& text );
+    void highlightSyntax( const QString& text, int checkpoint = -1 );
+    void highlightSegmented( const QString& text, int previousStartState );
+    void highlightPlain( const QString& text );
+    void restoreCheckpoint( int index );
+    void addCheckpoint( const QString& text, int position );
+    void compactFormats();
+    void formatToken( int start, int count, Token token, int modifiers = NoModifier, QRgb color = 0 );
+    void markContext( int start, int end, Token token );
+    void annotate( const QString& text );
+    void mergeOverlays( const QString& text );
+    void applyOverlays( const QTextBlock& block );
+    void indexBrackets( const QString& text );
+    void indexFolds( const QString& text );
+    Q_REQUIRED_RESULT bool usesIndentFolding() const;
+    void invalidateFolds( int blockNumber );
+    void updateFoldLevels( int upTo ) const;
+    void markSymbolsChanged( int firstBlock, int lastBlock );
+    void scheduleIndexSignals();
+    void flushIndexSignals();
     Q_REQUIRED_RESULT int highlightNumericLiterals( const QString& text, int i );
     Q_REQUIRED_RESULT int highlightStringLiterals(const QChar strType, const QString &text, int i);
 
@@ -113,27 +490,200 @@ private:
         return ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'));
     }
 
-#if QT_VERSION_MAJOR >= 6
+    // views into the text of the block, so the language passes never copy
+    // it, also on Qt 5
     typedef QStringView TextValue;
     typedef QStringView TextBuffer;
     typedef QStringView TextRef;
-#define MIDREF mid
-#else
-    typedef const QString &TextValue;
-    typedef const QString TextBuffer;
-    typedef const QStringRef TextRef;
-#define MIDREF midRef
-#endif
-    void cssHighlighter(TextValue text);
-    void ymlHighlighter(TextValue text);
-    void xmlHighlighter(TextValue text);
-    void makeHighlighter(TextValue text);
-    void highlightInlineAsmLabels(TextValue text);
-    void asmHighlighter(TextValue text);
+    /**
+     * @brief rules of a language, run by the scan of highlightSyntax()
+     * @details onWord is called after each word in code with where the
+     * word starts and where the scan is, onChar for the other chars in
+     * code that don't start a string, a comment or a number. Both return
+     * where the scan goes on, past what they formatted.
+     */
+    struct LanguageHooks
+    {
+        int ( QSourceHighlighter::*onWord )( TextValue text, int start, int end );
+        int ( QSourceHighlighter::*onChar )( TextValue text, int i );
+    };
+    /**
+     * @brief what the hooks found so far in the line
+     */
+    struct HookState
+    {
+        int  keyStart;      // first word in code, for yaml keys
+        bool done;          // the rule of the line was applied
+        bool colon;         // a colon was seen, css selectors come before
+        int  nextColon;     // see nextOf(), -2 before the first search
+        int  nextSemicolon;
+    };
+
+    static const LanguageHooks* languageHooks( const QString& language );
+    int                         cssWord( TextValue text, int start, int end );
+    int                         cssChar( TextValue text, int i );
+    int                         yamlWord( TextValue text, int start, int end );
+    int                         yamlChar( TextValue text, int i );
+    int                         makeChar( TextValue text, int i );
+    int                         asmWord( TextValue text, int start, int end );
+    int                         asmChar( TextValue text, int i );
+    void                        xmlHighlighter( TextValue text, bool contextsOnly = false );
+    void addSymbol( TextValue text, int start, int end, SymbolKind kind );
+
+    const QTextCharFormat &derivedFormat(Token token, int modifiers, QRgb color = 0);
+    QColor cssColor(TextValue color);
+
+    /**
+     * @brief where an xml block starts, relative to the language id
+     * @details Comments and values use the comment and string modes of
+     * the other languages.
+     */
+    enum XmlMode
+    {
+        XmlText,
+        XmlComment,
+        XmlValue,       // double quoted attribute value
+        XmlTag,         // after the name of a tag
+        XmlSingleValue, // single quoted attribute value
+        XmlCData,
+        XmlInstruction, // <? ... ?>
+        XmlDeclaration  // <!DOCTYPE ...> and the like
+    };
+
+    /**
+     * @brief a string or comment found in the block being highlighted
+     */
+    struct ContextSpan
+    {
+        int   start;
+        int   end;
+        Token token;
+    };
+
+    /**
+     * @brief what the worker found in a line, see setBackgroundLexing()
+     */
+    struct BackgroundLine
+    {
+        int                                 start; // state the line was lexed from
+        int                                 state; // state after the line
+        QVector< Span >                     spans; // relative to the line
+        QVector< ContextSpan >              contexts;
+        QVector< QSourceBlockData::Symbol > symbols;
+    };
+
+    /**
+     * @brief a run of blocks lexed on the worker, from firstBlock on
+     * @details The worker stops at the first block that wasn't marked and
+     * is entered in the state it was lexed with before, or at the end of
+     * the copied blocks, the blocks after that are marked when applying.
+     */
+    struct BackgroundJob
+    {
+        int                       revision; // of the document when the text was copied
+        const ALanguage*          language;
+        int                       firstBlock;
+        int                       start;
+        QVector< QString >        texts;
+        QVector< bool >           pending;
+        QVector< int >            oldStates; // state after each block, before this job
+        QVector< BackgroundLine > lines;
+        std::atomic< bool >       cancel{ false };
+    };
+    void lexBackgroundJob( BackgroundJob& job );
 
     Theme _theme;
+    QTextCharFormat                                   _tokenFormats[ TokenCount ]; // _theme as an array
     QChar                                             MultilineStringChar;
     ALanguage*                                        _language;
+    ALanguage*                                        _pendingLanguage;
+    const LanguageHooks*                              _hooks; // of _hooksLanguage
+    const ALanguage*                                  _hooksLanguage;
+    HookState                                         _hookState;
+    QSourceBlockData*                                 _blockData;
+    QVector< ContextSpan >                            _contextSpans;
+    QVector< QSourceBlockData::Symbol >               _previousSymbols;
+    QSharedPointer< QSourceIdentifierIndex >          _identifierIndex; // see setIdentifierIndexEnabled()
+    QVector< QSourceBlockData::Identifier >           _previousIdentifiers;
+    QVector< QPair< int, int > >                      _escapes; // escape sequences of the current string
+    QVector< Annotation >                             _annotations;
+    QSharedPointer< const AnnotationMatcher >         _annotationMatcher; // shared by highlighters using the same patterns
+    QByteArray                                        _annotationKey;     // for the cache, changes with the patterns
+
+    // long lines, see setLongLineLimits()
+    int                                               _segmentLength;
+    int                                               _plainLimit;
+    bool                                              _segmented;
+    int                                               _nextCheckpoint;
+    int                                               _formatEnd; // of the formats of tokens so far
+    QVector< QSourceBlockData::Checkpoint >           _previousCheckpoints;
+    QVector< QSourceBlockData::Format >               _previousFormats;
+    QVector< QSourceBlockData::Format >               _compactFormats; // buffers of compactFormats()
+    QVector< int >                                    _formatOwner;
+    QVector< QSourceBlockData::Context >              _previousContexts;
+    bool                                              _recordFormats; // also for blocks with overlays
+
+    // semantic tokens, the blocks changed by the running update
+    QHash< int, QTextCharFormat >                     _semanticFormats;
+    int                                               _semanticUpdates;
+    QVector< QTextBlock >                             _overlaysChanged;
+
+    // lexing state of the block being highlighted
+    int                                               _blockState;
+    int                                               _textLength;
+    int                                               _spanOffset;
+    bool                                              _headless;
+    QVector< Span >*                                  _spanSink;
+    QSourceBlockData                                  _lineData; // block data for highlightLine()
+
+    QSourceHighlightCache*                            _cache;
+    // the entry being recorded or replayed during setPlainText()
+    QSourceHighlightCacheEntry*                       _cacheEntry;
+    bool                                              _cacheReplay;
+    int                                               _cacheLine;
+    int                                               _cacheColor;
+    QVector< Span >                                   _cacheSpans;
+    // formats derived from _theme and parsed css colors, reset with the theme
+    QHash< quint64, QTextCharFormat >                 _derivedFormats;
+    QHash< uint, QPair< QString, QColor > >           _cssColors; // by qHash() of the value
+
+    // fold level at the start of each block, valid below _foldValid
+    mutable QVector< int >                            _foldLevels;
+    mutable int                                       _foldValid;
+    int                                               _foldChangedFrom;
+    int                                               _symbolsChangedFrom;
+    int                                               _symbolsChangedTo;
+    int                                               _blockCount;
+    bool                                              _indexSignalPending;
+
+    // see QSourceHighlightScheduler, a burst is an edit, a rehighlight or a slice
+    QSourceHighlightScheduler*                        _scheduler;
+    QElapsedTimer                                     _burstTimer;
+    qint64                                            _burstBudget; // nsecs, -1 outside of bursts
+    int                                               _burstLexed;
+    int                                               _burstDeferred;
+    int                                               _forcedBlock; // lexed in a slice whatever the budget
+    int                                               _pendingFrom; // no pending block before it, as far as known
+    int                                               _pendingBlocks;
+    // edit batching, the timer runs while edits are collected
+    bool                                              _editBatching;
+    QTimer                                            _batchTimer;
+    BatchStatistics                                   _batchStatistics;
+
+    // background lexing, _revision counts the edits of the document
+    bool                                              _backgroundLexing;
+    QSourceHighlighter*                               _backgroundLexer; // headless, used by the worker
+    QSharedPointer< BackgroundJob >                   _backgroundJob;   // running, or being applied
+    QFuture< void >                                   _backgroundFuture;
+    bool                                              _backgroundScheduled;
+    const BackgroundLine*                             _backgroundLine; // replayed by highlightBlock()
+    int                                               _backgroundBlock;
+    int                                               _revision;
+
+    bool                                              _followMode;
+    bool                                              _followHasLines;
+    bool                                              _followPartial; // the last block was flushed incomplete
+    QByteArray                                        _followTail; // incomplete last line
 
     static QMap<QString, Theme> Themes;
     int                                               CppID;
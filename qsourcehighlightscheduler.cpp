@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "qsourcehighlightscheduler.h"
+
+#include <QGuiApplication>
+
+QSourceHighlightScheduler::QSourceHighlightScheduler( QObject* parent )
+    : QObject( parent )
+    , _budget( 50 )
+    , _sliceLength( 8 )
+    , _immediateTime( 4 )
+    , _paused( false )
+    , _next( 0 )
+{
+    _timer.setInterval( 8 );
+    connect( &_timer, &QTimer::timeout, this, &QSourceHighlightScheduler::runSlice );
+
+    if ( qGuiApp != nullptr )
+    {
+        connect( qGuiApp, &QGuiApplication::applicationStateChanged, this, [ this ]( Qt::ApplicationState state ) {
+            _paused = state == Qt::ApplicationHidden || state == Qt::ApplicationSuspended;
+            if ( _paused )
+                _timer.stop();
+            else
+                wake();
+        } );
+    }
+}
+
+QSourceHighlightScheduler::~QSourceHighlightScheduler()
+{
+    const QList< Document > Documents = _documents;
+    for ( const Document& D : Documents )
+        removeHighlighter( D.highlighter );
+}
+
+void QSourceHighlightScheduler::addHighlighter( QSourceHighlighter* highlighter, Priority priority, QWindow* window )
+{
+    if ( highlighter->_scheduler == this )
+    {
+        setWindow( highlighter, window );
+        setPriority( highlighter, priority );
+        return;
+    }
+    if ( highlighter->_scheduler != nullptr )
+        highlighter->_scheduler->removeHighlighter( highlighter );
+
+    highlighter->_scheduler = this;
+    _documents.append( Document{ highlighter, priority, nullptr, -1, -1, Statistics() } );
+    setWindow( highlighter, window );
+}
+
+void QSourceHighlightScheduler::setWindow( QSourceHighlighter* highlighter, QWindow* window )
+{
+    Document* D = document( highlighter );
+    if ( D == nullptr )
+        return;
+    D->window = window;
+    // the documents of a window that is shown again have their slices
+    if ( window != nullptr )
+        connect( window, &QWindow::visibilityChanged, this, &QSourceHighlightScheduler::wake, Qt::UniqueConnection );
+    wake();
+}
+
+/**
+ * @brief the blocks still pending are lexed right away, the highlighter
+ * can't be left half highlighted
+ */
+void QSourceHighlightScheduler::removeHighlighter( QSourceHighlighter* highlighter )
+{
+    for ( int I = 0; I < _documents.size(); ++I )
+    {
+        if ( _documents[ I ].highlighter == highlighter )
+        {
+            _documents.removeAt( I );
+            break;
+        }
+    }
+    if ( highlighter->_scheduler != this )
+        return;
+
+    highlighter->endBurst();
+    highlighter->_scheduler = nullptr;
+    if ( highlighter->_pendingBlocks > 0 )
+    {
+        highlighter->_pendingBlocks = 0;
+        highlighter->rehighlight();
+    }
+}
+
+QSourceHighlightScheduler::Document* QSourceHighlightScheduler::document( QSourceHighlighter* highlighter )
+{
+    for ( Document& D : _documents )
+    {
+        if ( D.highlighter == highlighter )
+            return &D;
+    }
+    return nullptr;
+}
+
+const QSourceHighlightScheduler::Document* QSourceHighlightScheduler::document( QSourceHighlighter* highlighter ) const
+{
+    for ( const Document& D : _documents )
+    {
+        if ( D.highlighter == highlighter )
+            return &D;
+    }
+    return nullptr;
+}
+
+void QSourceHighlightScheduler::setPriority( QSourceHighlighter* highlighter, Priority priority )
+{
+    Document* D = document( highlighter );
+    if ( D == nullptr )
+        return;
+    D->priority = priority;
+    wake();
+}
+
+QSourceHighlightScheduler::Priority QSourceHighlightScheduler::effectivePriority( const Document& D )
+{
+    if ( D.window != nullptr && ( !D.window->isVisible() || D.window->visibility() == QWindow::Minimized ) )
+        return Hidden;
+    return D.priority;
+}
+
+QSourceHighlightScheduler::Priority QSourceHighlightScheduler::priority( QSourceHighlighter* highlighter ) const
+{
+    const Document* D = document( highlighter );
+    return ( D ) ? D->priority : Hidden;
+}
+
+void QSourceHighlightScheduler::setViewport( QSourceHighlighter* highlighter, int firstBlock, int lastBlock )
+{
+    Document* D = document( highlighter );
+    if ( D == nullptr )
+        return;
+    D->firstVisible = firstBlock;
+    D->lastVisible  = lastBlock;
+    wake();
+}
+
+void QSourceHighlightScheduler::setBudget( int percent )
+{
+    _budget = qBound( 1, percent, 100 );
+    _timer.setInterval( _sliceLength * ( 100 - _budget ) / _budget );
+}
+
+int QSourceHighlightScheduler::budget() const
+{
+    return _budget;
+}
+
+void QSourceHighlightScheduler::setSliceLength( int msecs )
+{
+    _sliceLength = qMax( 1, msecs );
+    _timer.setInterval( _sliceLength * ( 100 - _budget ) / _budget );
+}
+
+int QSourceHighlightScheduler::sliceLength() const
+{
+    return _sliceLength;
+}
+
+void QSourceHighlightScheduler::setImmediateTime( int msecs )
+{
+    _immediateTime = qMax( 0, msecs );
+}
+
+int QSourceHighlightScheduler::immediateTime() const
+{
+    return _immediateTime;
+}
+
+QSourceHighlightScheduler::Statistics QSourceHighlightScheduler::statistics( QSourceHighlighter* highlighter ) const
+{
+    const Document* D = document( highlighter );
+    if ( D == nullptr )
+        return Statistics();
+    Statistics S    = D->statistics;
+    S.pendingBlocks = highlighter->_pendingBlocks;
+    return S;
+}
+
+bool QSourceHighlightScheduler::isPaused() const
+{
+    return _paused;
+}
+
+void QSourceHighlightScheduler::wake()
+{
+    if ( !_paused && !_timer.isActive() )
+        _timer.start();
+}
+
+void QSourceHighlightScheduler::account( QSourceHighlighter* highlighter, int immediate, int deferred, int sliced )
+{
+    Document* D = document( highlighter );
+    if ( D == nullptr )
+        return;
+    D->statistics.immediateBlocks += immediate;
+    D->statistics.deferredBlocks += deferred;
+    D->statistics.slicedBlocks += sliced;
+}
+
+qint64 QSourceHighlightScheduler::immediateBudget( QSourceHighlighter* highlighter )
+{
+    const Document* D = document( highlighter );
+    if ( _paused || D == nullptr || effectivePriority( *D ) > Visible )
+        return 0;
+    return qint64( _immediateTime ) * 1000000;
+}
+
+/**
+ * @brief give a slice to the document with pending blocks of the highest
+ * priority, the documents of the same priority take turns
+ */
+void QSourceHighlightScheduler::runSlice()
+{
+    if ( _paused || _documents.isEmpty() )
+    {
+        _timer.stop();
+        return;
+    }
+
+    int Best = -1;
+    for ( int I = 0; I < _documents.size(); ++I )
+    {
+        const int       Index = ( _next + I ) % _documents.size();
+        const Document& D     = _documents.at( Index );
+        const Priority  P     = effectivePriority( D );
+        // edit batching lexes its blocks itself once the edits settled
+        if ( P == Hidden || D.highlighter->_pendingBlocks == 0 || D.highlighter->_batchTimer.isActive() )
+            continue;
+        if ( Best == -1 || P < effectivePriority( _documents.at( Best ) ) )
+            Best = Index;
+    }
+    if ( Best == -1 )
+    {
+        _timer.stop();
+        return;
+    }
+    _next = Best + 1;
+
+    Document&     D = _documents[ Best ];
+    QElapsedTimer T;
+    T.start();
+    D.highlighter->lexPending( qint64( _sliceLength ) * 1000000, D.firstVisible, D.lastVisible );
+    // lexPending() accounts the blocks, D is still valid as nothing is added meanwhile
+    D.statistics.sliceNsecs += T.nsecsElapsed();
+    ++D.statistics.slices;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "qsourcehighlighter.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QWindow>
+
+/**
+ * @brief Shares the highlighting work of many documents on the GUI thread
+ * @details A registered highlighter only spends a short time on an edit or
+ * a rehighlight right away, the blocks it didn't get to keep their previous
+ * formats and are lexed later in time slices. The slices go to the focused
+ * document first, then to the visible ones and then to the background ones,
+ * and within a document to its viewport first. Hidden documents, the
+ * documents of a hidden or minimized window and all documents while the
+ * application is hidden or suspended are paused. The slices take at most
+ * budget() percent of the time.
+ */
+class QSOURCEHIGHLIGHTER_EXPORT QSourceHighlightScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority
+    {
+        Focused,
+        Visible,
+        Background,
+        // e.g. a minimized window or a tab that isn't shown, nothing is lexed
+        Hidden
+    };
+
+    struct Statistics
+    {
+        int    pendingBlocks   = 0; // waiting for a slice
+        qint64 immediateBlocks = 0; // lexed right away, on an edit or rehighlight
+        qint64 deferredBlocks  = 0; // left for the slices
+        qint64 slicedBlocks    = 0; // lexed in slices
+        int    slices          = 0;
+        qint64 sliceNsecs      = 0; // time spent in slices
+    };
+
+    explicit QSourceHighlightScheduler( QObject* parent = nullptr );
+    ~QSourceHighlightScheduler() override;
+
+    /**
+     * @brief schedules highlighter until it is removed or destroyed
+     * @param window the window showing the document, while it is hidden or
+     * minimized the document is Hidden whatever its priority. Without one
+     * only the priority tells, desktop platforms don't hide the application
+     * when its windows are minimized.
+     */
+    void addHighlighter( QSourceHighlighter* highlighter, Priority priority = Background, QWindow* window = nullptr );
+    void removeHighlighter( QSourceHighlighter* highlighter );
+    void setWindow( QSourceHighlighter* highlighter, QWindow* window );
+
+    void                       setPriority( QSourceHighlighter* highlighter, Priority priority );
+    Q_REQUIRED_RESULT Priority priority( QSourceHighlighter* highlighter ) const;
+    /**
+     * @brief the blocks shown for the document, lexed before the others
+     */
+    void setViewport( QSourceHighlighter* highlighter, int firstBlock, int lastBlock );
+
+    /**
+     * @brief the share of the time spent in slices, in percent, 50 by default
+     */
+    void                  setBudget( int percent );
+    Q_REQUIRED_RESULT int budget() const;
+    /**
+     * @brief the length of a slice in msecs, 8 by default
+     */
+    void                  setSliceLength( int msecs );
+    Q_REQUIRED_RESULT int sliceLength() const;
+    /**
+     * @brief what a focused or visible document may spend on an edit right
+     * away in msecs, 4 by default. Background documents defer everything.
+     */
+    void                  setImmediateTime( int msecs );
+    Q_REQUIRED_RESULT int immediateTime() const;
+
+    Q_REQUIRED_RESULT Statistics statistics( QSourceHighlighter* highlighter ) const;
+    Q_REQUIRED_RESULT bool       isPaused() const;
+
+private:
+    friend class QSourceHighlighter;
+
+    struct Document
+    {
+        QSourceHighlighter* highlighter;
+        Priority            priority;
+        QPointer< QWindow > window;
+        int                 firstVisible;
+        int                 lastVisible;
+        Statistics          statistics;
+    };
+
+    Document*       document( QSourceHighlighter* highlighter );
+    const Document* document( QSourceHighlighter* highlighter ) const;
+    /**
+     * @brief the priority of D, Hidden while its window isn't shown
+     */
+    Q_REQUIRED_RESULT static Priority effectivePriority( const Document& D );
+    /**
+     * @brief called by the highlighters when they defer blocks
+     */
+    void wake();
+    void account( QSourceHighlighter* highlighter, int immediate, int deferred, int sliced );
+    /**
+     * @brief the time highlighter may spend right away, in nsecs
+     */
+    Q_REQUIRED_RESULT qint64 immediateBudget( QSourceHighlighter* highlighter );
+    void                     runSlice();
+
+    QList< Document > _documents;
+    QTimer            _timer;
+    int               _budget;
+    int               _sliceLength;
+    int               _immediateTime;
+    bool              _paused;
+    // the document after the last one served, to take turns within a priority
+    int _next;
+};
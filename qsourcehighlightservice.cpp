@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "qsourcehighlightservice.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QLocalServer>
+#include <QPointer>
+#include <QThreadStorage>
+#include <QtConcurrent>
+
+// the messages, in host byte order: both ends run on the same machine
+static const quint32 RequestMagic  = 0x52485351; // "QSHR"
+static const quint32 ResponseMagic = 0x41485351; // "QSHA"
+static const quint32 ServiceFormat = 1;
+// longer names are no language, longer texts no source file: a request
+// is buffered whole by the server, at most 32 MiB of UTF-16
+static const quint32 MaxLanguageBytes = 256;
+static const quint32 MaxTextChars     = 16 * 1024 * 1024;
+
+enum ResponseStatus : quint32
+{
+    ResponseOk,
+    ResponseUnknownLanguage
+};
+
+// followed by the language in UTF-8 and the text in UTF-16
+struct RequestHeader
+{
+    quint32 magic;
+    quint32 format;
+    quint32 languageBytes;
+    quint32 textChars;
+};
+
+// followed by the blob of QSourceHighlightCacheEntry::write()
+struct ResponseHeader
+{
+    quint32 magic;
+    quint32 status;
+    quint32 blobBytes;
+};
+
+QSourceHighlightServer::QSourceHighlightServer( QObject* parent )
+    : QObject( parent )
+    , _server( new QLocalServer( this ) )
+    , _results( 64 * 1024 * 1024 )
+    , _cache( nullptr )
+    , _requests( 0 )
+    , _hits( 0 )
+{
+    // the server lives as long as the session, load every language up front
+    QSourceHighlighter::warmUp();
+
+    connect( _server, &QLocalServer::newConnection, this, [ this ]() {
+        while ( QLocalSocket* socket = _server->nextPendingConnection() )
+        {
+            connect( socket, &QLocalSocket::readyRead, this, [ this, socket ]() { serve( socket ); } );
+            connect( socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater );
+            connect( socket, &QObject::destroyed, this, [ this, socket ]() { _busy.remove( socket ); } );
+        }
+    } );
+}
+
+QSourceHighlightServer::~QSourceHighlightServer()
+{
+    close();
+    // the running requests use the caches
+    _pool.waitForDone();
+}
+
+QString QSourceHighlightServer::defaultName()
+{
+    QString user = qEnvironmentVariable( "USER" );
+    if ( user.isEmpty() )
+        user = qEnvironmentVariable( "USERNAME" );
+    return QStringLiteral( "qsourcehighlighter-" ) + user;
+}
+
+bool QSourceHighlightServer::listen( const QString& name )
+{
+    _server->setSocketOptions( QLocalServer::UserAccessOption );
+    if ( _server->listen( name ) )
+        return true;
+
+    // a server that crashed leaves its socket file behind
+    if ( _server->serverError() == QAbstractSocket::AddressInUseError )
+    {
+        QLocalSocket probe;
+        probe.connectToServer( name );
+        if ( !probe.waitForConnected( 500 ) && QLocalServer::removeServer( name ) )
+            return _server->listen( name );
+    }
+    qWarning() << "Error listening on" << name << _server->errorString();
+    return false;
+}
+
+void QSourceHighlightServer::close()
+{
+    _server->close();
+}
+
+void QSourceHighlightServer::setMaximumCacheSize( int bytes )
+{
+    QMutexLocker lock( &_resultsMutex );
+    _results.setMaxCost( bytes );
+}
+
+int QSourceHighlightServer::maximumCacheSize() const
+{
+    QMutexLocker lock( &_resultsMutex );
+    return _results.maxCost();
+}
+
+void QSourceHighlightServer::setCache( QSourceHighlightCache* cache )
+{
+    QMutexLocker lock( &_cacheMutex );
+    _cache = cache;
+}
+
+qint64 QSourceHighlightServer::requestCount() const
+{
+    return _requests;
+}
+
+qint64 QSourceHighlightServer::cacheHits() const
+{
+    return _hits;
+}
+
+/**
+ * @brief answer the next request received on socket once it is complete
+ * @details The request is lexed on the pool, the following one of the
+ * connection waits for the answer so the answers keep their order.
+ */
+void QSourceHighlightServer::serve( QLocalSocket* socket )
+{
+    if ( _busy.contains( socket ) )
+        return;
+
+    RequestHeader Header;
+    if ( socket->bytesAvailable() < qint64( sizeof( Header ) ) )
+        return;
+    socket->peek( reinterpret_cast< char* >( &Header ), sizeof( Header ) );
+    if ( Header.magic != RequestMagic || Header.format != ServiceFormat || Header.languageBytes > MaxLanguageBytes || Header.textChars > MaxTextChars )
+    {
+        qWarning() << "Invalid highlighting request, closing the connection";
+        socket->abort();
+        return;
+    }
+    if ( socket->bytesAvailable() < qint64( sizeof( Header ) ) + Header.languageBytes + qint64( Header.textChars ) * 2 )
+        return;
+
+    socket->read( reinterpret_cast< char* >( &Header ), sizeof( Header ) );
+    const QString language = QString::fromUtf8( socket->read( Header.languageBytes ) );
+    QString       text( int( Header.textChars ), Qt::Uninitialized );
+    socket->read( reinterpret_cast< char* >( text.data() ), qint64( Header.textChars ) * 2 );
+
+    _busy.insert( socket );
+    const QPointer< QLocalSocket > connection( socket );
+    auto*                          watcher = new QFutureWatcher< Answer >( this );
+    connect( watcher, &QFutureWatcherBase::finished, this, [ this, watcher, connection ]() {
+        const Answer answer = watcher->result();
+        watcher->deleteLater();
+        if ( connection.isNull() )
+            return;
+
+        _busy.remove( connection.data() );
+        const ResponseHeader Response{ ResponseMagic, answer.status, quint32( answer.blob.size() ) };
+        connection->write( reinterpret_cast< const char* >( &Response ), sizeof( Response ) );
+        connection->write( answer.blob );
+        // a request that came meanwhile
+        serve( connection.data() );
+    } );
+    watcher->setFuture( QtConcurrent::run( &_pool, [ this, text, language ]() { return highlight( text, language ); } ) );
+}
+
+/**
+ * @brief the answer to a request, on a thread of the pool
+ */
+QSourceHighlightServer::Answer QSourceHighlightServer::highlight( const QString& text, const QString& language )
+{
+    // a headless highlighter per thread, highlightText() isn't reentrant
+    static QThreadStorage< QSourceHighlighter* > lexers;
+    if ( !lexers.hasLocalData() )
+        lexers.setLocalData( new QSourceHighlighter( nullptr ) );
+    QSourceHighlighter* lexer = lexers.localData();
+
+    ++_requests;
+    if ( !lexer->setCurrentLanguage( language ) )
+        return Answer{ ResponseUnknownLanguage, QByteArray() };
+
+    const QByteArray key = lexer->cacheKey( text );
+    {
+        QMutexLocker lock( &_resultsMutex );
+        if ( const QByteArray* blob = _results.object( key ) )
+        {
+            ++_hits;
+            return Answer{ ResponseOk, *blob };
+        }
+    }
+
+    QSourceHighlightCacheEntry entry;
+    bool                       cached;
+    {
+        QMutexLocker lock( &_cacheMutex );
+        cached = _cache != nullptr && _cache->load( key, entry );
+    }
+    if ( !cached )
+    {
+        lexer->highlightText( text, entry );
+        QMutexLocker lock( &_cacheMutex );
+        if ( _cache != nullptr )
+            _cache->store( key, entry );
+    }
+
+    QByteArray blob;
+    QBuffer    B( &blob );
+    B.open( QIODevice::WriteOnly );
+    entry.write( B );
+    B.close();
+
+    QMutexLocker lock( &_resultsMutex );
+    // too large ones are dropped right away
+    if ( blob.size() <= _results.maxCost() )
+        _results.insert( key, new QByteArray( blob ), blob.size() );
+    return Answer{ ResponseOk, blob };
+}
+
+QSourceHighlightClient::QSourceHighlightClient( const QString& serverName )
+    : _serverName( serverName )
+    , _fallback( nullptr )
+    , _timeout( 2000 )
+    , _usedServer( false )
+{
+}
+
+QSourceHighlightClient::~QSourceHighlightClient()
+{
+    delete _fallback;
+}
+
+void QSourceHighlightClient::setTimeout( int msecs )
+{
+    _timeout = msecs;
+}
+
+int QSourceHighlightClient::timeout() const
+{
+    return _timeout;
+}
+
+bool QSourceHighlightClient::usedServer() const
+{
+    return _usedServer;
+}
+
+bool QSourceHighlightClient::highlight( const QString& text, const QString& language, QSourceHighlightCacheEntry& highlighting )
+{
+    _usedServer = request( text, language, highlighting );
+    if ( _usedServer )
+        return true;
+
+    // no server, or one that doesn't know the language, e.g. one added
+    // to this process with QSourceHighlighter::addLanguage()
+    if ( _fallback == nullptr )
+        _fallback = new QSourceHighlighter( nullptr );
+    if ( !_fallback->setCurrentLanguage( language ) )
+    {
+        highlighting.clear();
+        return false;
+    }
+    _fallback->highlightText( text, highlighting );
+    return true;
+}
+
+QFuture< QSourceHighlightCacheEntry > QSourceHighlightClient::highlightAsync( const QString& text, const QString& language ) const
+{
+    const QString serverName = _serverName;
+    const int     msecs      = _timeout;
+    return QtConcurrent::run( [ serverName, msecs, text, language ]() {
+        QSourceHighlightClient     client( serverName );
+        QSourceHighlightCacheEntry highlighting;
+        client.setTimeout( msecs );
+        client.highlight( text, language, highlighting );
+        return highlighting;
+    } );
+}
+
+/**
+ * @brief ask the server, connecting to it first if needed
+ * @returns false if there is no server or it didn't answer with a result
+ */
+bool QSourceHighlightClient::request( const QString& text, const QString& language, QSourceHighlightCacheEntry& highlighting )
+{
+    const QByteArray name = language.toUtf8();
+    if ( quint32( name.size() ) > MaxLanguageBytes || quint32( text.size() ) > MaxTextChars )
+        return false;
+
+    if ( _socket.state() != QLocalSocket::ConnectedState )
+    {
+        _socket.connectToServer( _serverName );
+        if ( !_socket.waitForConnected( _timeout ) )
+        {
+            _socket.abort();
+            return false;
+        }
+    }
+
+    const RequestHeader Header{ RequestMagic, ServiceFormat, quint32( name.size() ), quint32( text.size() ) };
+    _socket.write( reinterpret_cast< const char* >( &Header ), sizeof( Header ) );
+    _socket.write( name );
+    _socket.write( reinterpret_cast< const char* >( text.constData() ), qint64( text.size() ) * 2 );
+    while ( _socket.bytesToWrite() > 0 )
+    {
+        if ( !_socket.waitForBytesWritten( _timeout ) )
+        {
+            _socket.abort();
+            return false;
+        }
+    }
+
+    ResponseHeader Response;
+    if ( !waitForBytes( sizeof( Response ) ) )
+        return false;
+    _socket.read( reinterpret_cast< char* >( &Response ), sizeof( Response ) );
+    if ( Response.magic != ResponseMagic || !waitForBytes( Response.blobBytes ) )
+    {
+        _socket.abort();
+        return false;
+    }
+
+    QByteArray blob = _socket.read( Response.blobBytes );
+    if ( Response.status != ResponseOk )
+        return false;
+    QBuffer B( &blob );
+    B.open( QIODevice::ReadOnly );
+    return highlighting.read( B );
+}
+
+bool QSourceHighlightClient::waitForBytes( qint64 bytes )
+{
+    while ( _socket.bytesAvailable() < bytes )
+    {
+        if ( !_socket.waitForReadyRead( _timeout ) )
+        {
+            _socket.abort();
+            return false;
+        }
+    }
+    return true;
+}
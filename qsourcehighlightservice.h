@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "qsourcehighlightcache.h"
+#include "qsourcehighlighter.h"
+
+#include <QByteArray>
+#include <QCache>
+#include <QFuture>
+#include <QLocalSocket>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <atomic>
+
+class QLocalServer;
+
+/**
+ * @brief Highlights texts for the processes of a user, over a local socket
+ * @details Tools on the same host then share the loaded languages and the
+ * results: the highlighting of a text is cached by its content, language
+ * and lexer version, and answered with the blob of
+ * QSourceHighlightCacheEntry::write(). Requests are lexed on a pool of
+ * worker threads, so a large file doesn't hold up the other clients; the
+ * requests of one connection are answered in order. See
+ * QSourceHighlightClient, and the qsourcehighlightd daemon in daemon/.
+ */
+class QSOURCEHIGHLIGHTER_EXPORT QSourceHighlightServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QSourceHighlightServer( QObject* parent = nullptr );
+    ~QSourceHighlightServer() override;
+
+    /**
+     * @brief the socket name of the user's service
+     */
+    Q_REQUIRED_RESULT static QString defaultName();
+
+    /**
+     * @brief serve on name, only to the user running the server
+     * @returns false if name can't be listened on, e.g. another server runs
+     */
+    bool listen( const QString& name = defaultName() );
+    void close();
+
+    /**
+     * @brief size of the results kept in memory, 64 MiB by default
+     */
+    void                  setMaximumCacheSize( int bytes );
+    Q_REQUIRED_RESULT int maximumCacheSize() const;
+    /**
+     * @brief also keep the results in cache, e.g. across restarts,
+     * nullptr to only keep them in memory
+     */
+    void setCache( QSourceHighlightCache* cache );
+
+    Q_REQUIRED_RESULT qint64 requestCount() const;
+    Q_REQUIRED_RESULT qint64 cacheHits() const;
+
+private:
+    struct Answer
+    {
+        quint32    status;
+        QByteArray blob;
+    };
+
+    void serve( QLocalSocket* socket );
+    Q_REQUIRED_RESULT Answer highlight( const QString& text, const QString& language );
+
+    QLocalServer*                    _server;
+    QThreadPool                      _pool;
+    QSet< QLocalSocket* >            _busy;    // connections with a request on the pool
+    mutable QMutex                   _resultsMutex;
+    QCache< QByteArray, QByteArray > _results; // blobs by cache key, the cost is their size
+    QMutex                           _cacheMutex;
+    QSourceHighlightCache*           _cache;
+    std::atomic< qint64 >            _requests;
+    std::atomic< qint64 >            _hits;
+};
+
+/**
+ * @brief Highlights texts with the QSourceHighlightServer of the user, or
+ * in process when there is none
+ * @details highlight() blocks until the result is there, for up to the
+ * timeout per step; GUI threads use highlightAsync() instead. A client is
+ * used by one thread at a time. Set the result on a document with
+ * QSourceHighlighter::setPlainText().
+ */
+class QSOURCEHIGHLIGHTER_EXPORT QSourceHighlightClient
+{
+public:
+    explicit QSourceHighlightClient( const QString& serverName = QSourceHighlightServer::defaultName() );
+    ~QSourceHighlightClient();
+
+    /**
+     * @brief how long to wait for the server before lexing in process, 2000 ms by default
+     */
+    void                  setTimeout( int msecs );
+    Q_REQUIRED_RESULT int timeout() const;
+
+    /**
+     * @brief the highlighting of text in language
+     * @returns false if language is unknown
+     */
+    bool highlight( const QString& text, const QString& language, QSourceHighlightCacheEntry& highlighting );
+    /**
+     * @brief highlight() on a worker thread, with a connection of its own
+     * @returns the highlighting, empty if language is unknown
+     */
+    Q_REQUIRED_RESULT QFuture< QSourceHighlightCacheEntry > highlightAsync( const QString& text, const QString& language ) const;
+    /**
+     * @brief true if the last highlight() was answered by the server
+     */
+    Q_REQUIRED_RESULT bool usedServer() const;
+
+private:
+    bool request( const QString& text, const QString& language, QSourceHighlightCacheEntry& highlighting );
+    bool waitForBytes( qint64 bytes );
+
+    QString             _serverName;
+    QLocalSocket        _socket;
+    QSourceHighlighter* _fallback; // created on first use
+    int                 _timeout;
+    bool                _usedServer;
+};
@@ -0,0 +1,14 @@
+QT       += core gui testlib
+
+# highlightBlock() must not allocate once a document was highlighted
+TARGET = tst_allocations
+
+CONFIG += c++11 console testcase qsourcehighlighter_no_widgets
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QSOURCEHIGHLIGHTER_TEST_FILES=\\\"$$PWD/../../test_files\\\"
+
+include(../../QSourceHighlighter.pri)
+
+SOURCES += \
+    tst_allocations.cpp
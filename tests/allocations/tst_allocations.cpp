@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <qsourcehighlighter.h>
+
+#include <QFile>
+#include <QGuiApplication>
+#include <QTextDocument>
+#include <QtTest/QTest>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// counted on the thread running highlightBlock() only
+static std::atomic<qint64> allocations{0};
+static thread_local bool counting = false;
+
+static inline void countAllocation()
+{
+    if (counting)
+        ++allocations;
+}
+
+#ifdef __GLIBC__
+// Qt's containers and strings allocate with malloc(), not operator new,
+// so on glibc the C allocation functions are counted as well
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+#endif
+
+void *operator new(std::size_t size)
+{
+#ifndef __GLIBC__
+    countAllocation();
+#endif
+    void *pointer = std::malloc(size ? size : 1);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+#ifndef __GLIBC__
+    countAllocation();
+#endif
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+/**
+ * @brief counts the allocations made while lexing a block
+ */
+class CountingHighlighter : public QSourceHighlighter
+{
+public:
+    using QSourceHighlighter::QSourceHighlighter;
+
+    int blocks = 0;
+
+protected:
+    void highlightBlock(const QString &text) override
+    {
+        ++blocks;
+        counting = true;
+        QSourceHighlighter::highlightBlock(text);
+        counting = false;
+    }
+};
+
+class tst_Allocations : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void highlightBlock_data();
+    void highlightBlock();
+};
+
+void tst_Allocations::highlightBlock_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<QString>("language");
+
+    QTest::newRow("cpp") << "C++.txt" << "cpp";
+    QTest::newRow("c") << "C.txt" << "c";
+    QTest::newRow("go") << "Go.txt" << "go";
+    QTest::newRow("lua") << "Lua.txt" << "lua";
+    // the rules with hooks: colors, keys and links, labels, tags
+    QTest::newRow("css") << "Css.txt" << "css";
+    QTest::newRow("yaml") << "Yaml.txt" << "yaml";
+    QTest::newRow("asm") << "Asm.txt" << "asm";
+    QTest::newRow("xml") << "Xml.txt" << "xml";
+}
+
+void tst_Allocations::highlightBlock()
+{
+    QFETCH(QString, file);
+    QFETCH(QString, language);
+
+    QFile f(QStringLiteral(QSOURCEHIGHLIGHTER_TEST_FILES "/") + file);
+    QVERIFY(f.open(QIODevice::ReadOnly | QIODevice::Text));
+    const QString sample = QString::fromUtf8(f.readAll());
+    QString text;
+    for (int r = 0; r < 50; ++r)
+        text += sample;
+
+    QTextDocument document;
+    CountingHighlighter highlighter(&document);
+    QVERIFY(highlighter.setCurrentLanguage(language));
+    // the rehighlight queued when the highlighter was attached
+    QCoreApplication::processEvents();
+
+    // the first passes load the language, and size the block data and the
+    // buffers that are reused from then on
+    document.setPlainText(text);
+    highlighter.rehighlight();
+
+    highlighter.blocks = 0;
+    allocations = 0;
+    highlighter.rehighlight();
+    QCOMPARE(highlighter.blocks, document.blockCount());
+    QCOMPARE(allocations.load(), qint64(0));
+}
+
+int main(int argc, char *argv[])
+{
+    // QTextDocument needs a QGuiApplication, but no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication a(argc, argv);
+    tst_Allocations test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_allocations.moc"
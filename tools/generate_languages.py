@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020 Waqar Ahmed -- <waqar.17a@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Converts the language definitions into static C++ tables.
+
+Used by QSourceHighlighter.pri with CONFIG += qsourcehighlighter_static_languages
+
+usage: generate_languages.py <languages/languages.json> <output.cpp>
+"""
+
+import hashlib
+import json
+import os
+import sys
+
+CATEGORIES = ("types", "keywords", "builtin", "literals", "others")
+LINE_WIDTH = 100
+
+
+def escape(text):
+    """Escapes text for a u"" literal."""
+    out = []
+    for c in text:
+        if c in '\\"?':
+            out.append("\\" + c)
+        elif " " <= c <= "~":
+            out.append(c)
+        elif ord(c) > 0xFFFF:
+            out.append("\\U%08x" % ord(c))
+        else:
+            out.append("\\u%04x" % ord(c))
+    return "".join(out)
+
+
+def char_literal(value):
+    if not value:
+        return "0"
+    return "u'%s'" % escape(value[0]).replace("'", "\\'")
+
+
+def category_words(defs, category):
+    # the definition files use "other" for the "others" dictionary
+    values = defs.get(category, [])
+    if category == "others":
+        values = values or defs.get("other", [])
+    return sorted(set(w for w in values if w))
+
+
+def definition_version(data):
+    """Same as LanguageDefinition::version for the JSON file, so caches are shared
+    between static and JSON builds."""
+    return hashlib.sha1(data).hexdigest()[:16]
+
+
+def word_tables(defs, name, suffix, pool, offset, out):
+    """Appends the words of defs to pool and their tables to out.
+    Returns the C++ word lists and the new pool offset."""
+    tables = {}
+    for category in CATEGORIES:
+        entries = []
+        for word in category_words(defs, category):
+            entries.append((offset, len(word.encode("utf-16-le")) // 2))
+            pool.append(word)
+            offset += entries[-1][1]
+        tables[category] = entries
+
+    lists = []
+    for category in CATEGORIES:
+        entries = tables[category]
+        if not entries:
+            lists.append("{ nullptr, 0 }")
+            continue
+        out.append("const LanguageWord %s_%s%s[] = {" % (category, name, suffix))
+        for i in range(0, len(entries), 8):
+            out.append("    " + " ".join("{ %d, %d }," % e for e in entries[i:i + 8]))
+        out.append("};")
+        out.append("")
+        lists.append("{ %s_%s%s, %d }" % (category, name, suffix, len(entries)))
+    return lists, offset
+
+
+def generate_definition(name, data, out):
+    defs = json.loads(data.decode("utf-8"))
+    pool = []
+    tables = []
+    lists, offset = word_tables(defs, name, "", pool, 0, tables)
+
+    # the dialects, loaded on demand, share the pool of the definition
+    shards = []
+    for index, shard in enumerate(defs.get("shards", [])):
+        shard_lists, offset = word_tables(shard, name, "_%d" % index, pool, offset, tables)
+        shards.append('    { "%s", "%s", %s },' % (
+            escape(shard["name"]), escape(shard.get("prefix", "")), ", ".join(shard_lists)))
+
+    text = "".join(pool)
+    out.append("const char16_t pool_%s[] =" % name)
+    if not text:
+        out.append('    u"";')
+    else:
+        chunks = [text[i:i + LINE_WIDTH] for i in range(0, len(text), LINE_WIDTH)]
+        for i, chunk in enumerate(chunks):
+            out.append('    u"%s"%s' % (escape(chunk), ";" if i == len(chunks) - 1 else ""))
+    out.append("")
+    out += tables
+
+    if shards:
+        out.append("const LanguageShardTable shards_%s[] = {" % name)
+        out += shards
+        out.append("};")
+        out.append("")
+
+    return '    { "%s", "%s", %s, %s, %s, pool_%s, %s, %s, %d },' % (
+        name,
+        definition_version(data),
+        char_literal(defs.get("comment", "")),
+        char_literal(defs.get("multilinestringchar", "")),
+        "true" if defs.get("caseInsensitive", False) else "false",
+        name,
+        ", ".join(lists),
+        "shards_%s" % name if shards else "nullptr",
+        len(shards))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    index_file, output_file = sys.argv[1], sys.argv[2]
+    directory = os.path.dirname(index_file)
+
+    with open(index_file, encoding="utf-8") as f:
+        languages = json.load(f)
+
+    out = ["// Generated by tools/generate_languages.py from languages/*.json, do not edit.",
+           "",
+           '#include "languagetables.h"',
+           "",
+           "namespace",
+           "{",
+           ""]
+
+    # sorted like the QVariantMap the JSON loader iterates, so ids match
+    definitions = []
+    for key in sorted(languages):
+        definition = languages[key]["name"]
+        if definition not in definitions:
+            definitions.append(definition)
+
+    rows = []
+    for definition in definitions:
+        with open(os.path.join(directory, "language_%s.json" % definition), "rb") as f:
+            rows.append(generate_definition(definition, f.read(), out))
+
+    language_rows = []
+    for key in sorted(languages):
+        extensions = languages[key].get("extensions", [])
+        if extensions:
+            out.append("const char* const extensions_%s[] = { %s };" % (
+                key, ", ".join('"%s"' % escape(e) for e in extensions)))
+            language_rows.append('    { "%s", "%s", extensions_%s, %d },' % (
+                key, languages[key]["name"], key, len(extensions)))
+        else:
+            language_rows.append('    { "%s", "%s", nullptr, 0 },' % (key, languages[key]["name"]))
+
+    out += ["",
+            "} // namespace",
+            "",
+            "extern const LanguageDefinitionTable LanguageDefinitionTables[] = {"]
+    out += rows
+    out += ["};",
+            "extern const int LanguageDefinitionTableCount = %d;" % len(rows),
+            "",
+            "extern const LanguageTable LanguageTables[] = {"]
+    out += language_rows
+    out += ["};",
+            "extern const int LanguageTableCount = %d;" % len(language_rows),
+            ""]
+
+    with open(output_file, "w", encoding="utf-8") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()